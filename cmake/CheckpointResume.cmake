@@ -0,0 +1,28 @@
+# A render killed mid-frame and resumed from its checkpoint must write the same image,
+# byte for byte, as one that ran straight through. Invoked by ctest with
+# -DRT_OFFLINE=<path> -DWORK_DIR=<path>
+set(ARGS --width 64 --height 48 --tile 16 --samples 4 --threshold 0 --threads 1 --quiet)
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+execute_process(COMMAND ${RT_OFFLINE} ${ARGS} --output ${WORK_DIR}/straight.pfm RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "straight render failed: ${result}")
+endif()
+
+# 12 tiles a frame, the process dies half way through the second one
+execute_process(COMMAND ${RT_OFFLINE} ${ARGS} --checkpoint ${WORK_DIR}/render.ckpt --exit-after-tiles 18 --output ${WORK_DIR}/killed.pfm RESULT_VARIABLE result)
+if(result EQUAL 0)
+	message(FATAL_ERROR "the interrupted render ran to completion")
+endif()
+
+execute_process(COMMAND ${RT_OFFLINE} ${ARGS} --checkpoint ${WORK_DIR}/render.ckpt --output ${WORK_DIR}/resumed.pfm RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "resumed render failed: ${result}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/straight.pfm ${WORK_DIR}/resumed.pfm RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "the resumed render differs from the straight one")
+endif()
@@ -0,0 +1,19 @@
+# The megakernel and the wavefront integrator must render the same image, byte for
+# byte, lit by emissive spheres so light sampling is covered too. Invoked by ctest
+# with -DRT_OFFLINE=<path> -DWORK_DIR=<path>
+set(ARGS --width 96 --height 64 --samples 4 --threshold 0 --lights 8 --quiet)
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+foreach(integrator megakernel wavefront)
+	execute_process(COMMAND ${RT_OFFLINE} ${ARGS} --integrator ${integrator} --output ${WORK_DIR}/${integrator}.pfm RESULT_VARIABLE result)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "${integrator} render failed: ${result}")
+	endif()
+endforeach()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/megakernel.pfm ${WORK_DIR}/wavefront.pfm RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "the wavefront image differs from the megakernel one")
+endif()
@@ -0,0 +1,77 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <cfloat>
+#include "Ray.h"
+
+// Single minss/maxss. fminf/fmaxf must return the other operand for a NaN, which GCC
+// only does through a libm call, far too slow for the slab test
+inline float FastMin(float a, float b) noexcept { return a < b ? a : b; }
+inline float FastMax(float a, float b) noexcept { return a > b ? a : b; }
+
+struct AABB
+{
+	constexpr AABB() noexcept : min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+	constexpr AABB(const Vec3f& Min, const Vec3f& Max) noexcept : min(Min), max(Max) {}
+
+	void Grow(const Vec3f& p) noexcept
+	{
+		min = Vec3f(FastMin(min.x, p.x), FastMin(min.y, p.y), FastMin(min.z, p.z));
+		max = Vec3f(FastMax(max.x, p.x), FastMax(max.y, p.y), FastMax(max.z, p.z));
+	}
+
+	void Grow(const AABB& other) noexcept
+	{
+		min = Vec3f(FastMin(min.x, other.min.x), FastMin(min.y, other.min.y), FastMin(min.z, other.min.z));
+		max = Vec3f(FastMax(max.x, other.max.x), FastMax(max.y, other.max.y), FastMax(max.z, other.max.z));
+	}
+
+	Vec3f Centroid() const noexcept
+	{
+		return 0.5f * (min + max);
+	}
+
+	Vec3f Extent() const noexcept
+	{
+		return max - min;
+	}
+
+	// Half of the real surface area, the SAH only cares about ratios
+	float HalfArea() const noexcept
+	{
+		if (min.x > max.x)
+		{
+			return 0.0f;
+		}
+		const Vec3f e = Extent();
+		return e.x * e.y + e.y * e.z + e.z * e.x;
+	}
+
+	// Slab test, returns the entry distance or FLT_MAX on a miss
+	float Intersect(const Vec3f& origin, const Vec3f& invDir, float t_min, float t_max) const noexcept
+	{
+		const float tx1 = (min.x - origin.x) * invDir.x, tx2 = (max.x - origin.x) * invDir.x;
+		float tNear = FastMin(tx1, tx2), tFar = FastMax(tx1, tx2);
+		const float ty1 = (min.y - origin.y) * invDir.y, ty2 = (max.y - origin.y) * invDir.y;
+		tNear = FastMax(tNear, FastMin(ty1, ty2)); tFar = FastMin(tFar, FastMax(ty1, ty2));
+		const float tz1 = (min.z - origin.z) * invDir.z, tz2 = (max.z - origin.z) * invDir.z;
+		tNear = FastMax(tNear, FastMin(tz1, tz2)); tFar = FastMin(tFar, FastMax(tz1, tz2));
+
+		tNear = FastMax(tNear, t_min);
+		tFar = FastMin(tFar, t_max);
+		return tNear <= tFar ? tNear : FLT_MAX;
+	}
+
+	Vec3f min;
+	Vec3f max;
+};
+
+inline Vec3f SafeInverse(const Vec3f& d) noexcept
+{
+	// keeps the slab test NaN free for axis aligned rays
+	return Vec3f(1.0f / (fabsf(d.x) > 1e-20f ? d.x : copysignf(1e-20f, d.x)),
+				 1.0f / (fabsf(d.y) > 1e-20f ? d.y : copysignf(1e-20f, d.y)),
+				 1.0f / (fabsf(d.z) > 1e-20f ? d.z : copysignf(1e-20f, d.z)));
+}
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include "AABB.h"
+#include "RayPacket.h"
+#include "Stats.h"
+
+// Binary bounding volume hierarchy built with a binned surface area heuristic.
+// The tree only knows about primitive bounds, leaves are intersected through a
+// caller-provided functor so the inner loop stays monomorphic
+class BVH
+{
+public:
+	struct Node
+	{
+		AABB bounds;
+		uint32_t leftFirst = 0; // left child index for interior nodes, first primitive index for leaves
+		uint32_t count = 0;     // primitive count, 0 for interior nodes (right child = leftFirst + 1)
+
+		bool IsLeaf() const noexcept { return count > 0; }
+	};
+
+	static constexpr uint32_t SAH_BINS = 16;
+	static constexpr uint32_t MAX_LEAF_SIZE = 8;
+	static constexpr uint32_t MAX_DEPTH = 64;
+
+	void Build(const std::vector<AABB>& primitiveBounds);
+
+	// LeafFunc: bool(uint32_t first, uint32_t count, float& t_max), returns true and shrinks t_max on a closer hit.
+	// The primitive behind slot i of a leaf is PrimitiveIndices()[i]
+	template <typename LeafFunc>
+	bool Traverse(const Ray& r, float t_min, float t_max, LeafFunc&& intersectLeaf) const noexcept
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		const Vec3f invDir = SafeInverse(r.direction);
+		if (m_nodes[0].bounds.Intersect(r.origin, invDir, t_min, t_max) == FLT_MAX)
+		{
+			return false;
+		}
+
+		struct StackEntry { uint32_t node; float tNear; };
+		StackEntry stack[MAX_DEPTH * 2];
+		uint32_t stackSize = 0;
+
+		bool hitAnything = false;
+		uint32_t nodeIndex = 0;
+
+		while (true)
+		{
+			const Node& node = m_nodes[nodeIndex];
+			RT_STAT_ADD(STATS::BVH_NODES, 1);
+
+			if (node.IsLeaf())
+			{
+				hitAnything |= intersectLeaf(node.leftFirst, node.count, t_max);
+			}
+			else
+			{
+				uint32_t nearChild = node.leftFirst;
+				uint32_t farChild = node.leftFirst + 1;
+				float dNear = m_nodes[nearChild].bounds.Intersect(r.origin, invDir, t_min, t_max);
+				float dFar = m_nodes[farChild].bounds.Intersect(r.origin, invDir, t_min, t_max);
+
+				if (dFar < dNear)
+				{
+					std::swap(nearChild, farChild);
+					std::swap(dNear, dFar);
+				}
+
+				if (dNear != FLT_MAX)
+				{
+					if (dFar != FLT_MAX)
+					{
+						stack[stackSize++] = { farChild, dFar };
+					}
+					nodeIndex = nearChild;
+					continue;
+				}
+			}
+
+			// pop, skipping anything that starts past the current closest hit
+			bool found = false;
+			while (stackSize > 0)
+			{
+				const StackEntry entry = stack[--stackSize];
+				if (entry.tNear <= t_max)
+				{
+					nodeIndex = entry.node;
+					found = true;
+					break;
+				}
+			}
+			if (!found)
+			{
+				break;
+			}
+		}
+
+		return hitAnything;
+	}
+
+	// Any-hit traversal for shadow and visibility rays: t_max never shrinks and the
+	// first leaf reporting a hit ends the walk. Children are still visited near first,
+	// the nearer one is the likelier occluder.
+	// OccludedLeafFunc: bool(uint32_t first, uint32_t count), true on any hit inside the ray's range
+	template <typename OccludedLeafFunc>
+	bool TraverseAny(const Ray& r, float t_min, float t_max, OccludedLeafFunc&& occludedLeaf) const noexcept
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		const Vec3f invDir = SafeInverse(r.direction);
+		if (m_nodes[0].bounds.Intersect(r.origin, invDir, t_min, t_max) == FLT_MAX)
+		{
+			return false;
+		}
+
+		uint32_t stack[MAX_DEPTH * 2];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		while (true)
+		{
+			const Node& node = m_nodes[nodeIndex];
+			RT_STAT_ADD(STATS::BVH_NODES, 1);
+
+			if (node.IsLeaf())
+			{
+				if (occludedLeaf(node.leftFirst, node.count))
+				{
+					return true;
+				}
+			}
+			else
+			{
+				uint32_t nearChild = node.leftFirst;
+				uint32_t farChild = node.leftFirst + 1;
+				float dNear = m_nodes[nearChild].bounds.Intersect(r.origin, invDir, t_min, t_max);
+				float dFar = m_nodes[farChild].bounds.Intersect(r.origin, invDir, t_min, t_max);
+
+				if (dFar < dNear)
+				{
+					std::swap(nearChild, farChild);
+					std::swap(dNear, dFar);
+				}
+
+				if (dNear != FLT_MAX)
+				{
+					if (dFar != FLT_MAX)
+					{
+						stack[stackSize++] = farChild;
+					}
+					nodeIndex = nearChild;
+					continue;
+				}
+			}
+
+			if (stackSize == 0)
+			{
+				return false;
+			}
+			nodeIndex = stack[--stackSize];
+		}
+	}
+
+#if RAY_PACKETS
+	// Traverse for a whole packet. A node is entered while any lane hits it, each
+	// leaf only sees the lanes that hit its box.
+	// PacketLeafFunc: void(uint32_t first, uint32_t count, uint32_t laneMask), shrinks packet.tMax on closer hits
+	template <typename PacketLeafFunc>
+	void TraversePacket(RayPacket& packet, float t_min, PacketLeafFunc&& intersectLeaf) const noexcept
+	{
+		float rootEntry = 0.0f;
+		if (m_nodes.empty() || !packet.Intersect(m_nodes[0].bounds, t_min, rootEntry))
+		{
+			return;
+		}
+
+		struct StackEntry { uint32_t node; float tNear; };
+		StackEntry stack[MAX_DEPTH * 2];
+		uint32_t stackSize = 0;
+
+		uint32_t nodeIndex = 0;
+		uint32_t laneMask = packet.activeMask;
+		float farthest = packet.FarthestHit();
+
+		while (true)
+		{
+			const Node& node = m_nodes[nodeIndex];
+			RT_STAT_ADD(STATS::BVH_NODES, 1);
+
+			if (node.IsLeaf())
+			{
+				intersectLeaf(node.leftFirst, node.count, laneMask);
+				farthest = packet.FarthestHit();
+			}
+			else
+			{
+				uint32_t nearChild = node.leftFirst;
+				uint32_t farChild = node.leftFirst + 1;
+				float dNear = FLT_MAX;
+				float dFar = FLT_MAX;
+				uint32_t nearMask = packet.Intersect(m_nodes[nearChild].bounds, t_min, dNear);
+				uint32_t farMask = packet.Intersect(m_nodes[farChild].bounds, t_min, dFar);
+				dNear = nearMask ? dNear : FLT_MAX;
+				dFar = farMask ? dFar : FLT_MAX;
+
+				if (dFar < dNear)
+				{
+					std::swap(nearChild, farChild);
+					std::swap(dNear, dFar);
+					std::swap(nearMask, farMask);
+				}
+
+				if (nearMask)
+				{
+					if (farMask)
+					{
+						stack[stackSize++] = { farChild, dFar };
+					}
+					nodeIndex = nearChild;
+					laneMask = nearMask;
+					continue;
+				}
+			}
+
+			// pop, skipping nodes every lane already has a closer hit than; the lanes of
+			// a popped node are tested again as they may have found closer hits meanwhile
+			bool found = false;
+			while (stackSize > 0)
+			{
+				const StackEntry entry = stack[--stackSize];
+				float entryDistance = 0.0f;
+				if (entry.tNear <= farthest && (laneMask = packet.Intersect(m_nodes[entry.node].bounds, t_min, entryDistance)) != 0)
+				{
+					nodeIndex = entry.node;
+					found = true;
+					break;
+				}
+			}
+			if (!found)
+			{
+				break;
+			}
+		}
+	}
+#endif
+
+	bool Empty() const noexcept { return m_nodes.empty(); }
+	const std::vector<Node>& Nodes() const noexcept { return m_nodes; }
+	const std::vector<uint32_t>& PrimitiveIndices() const noexcept { return m_primitiveIndices; }
+
+private:
+	void Subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& primitiveBounds, const std::vector<Vec3f>& centroids);
+	float FindBestSplit(const Node& node, const std::vector<AABB>& primitiveBounds, const std::vector<Vec3f>& centroids, int& bestAxis, float& bestSplit) const noexcept;
+	void UpdateBounds(Node& node, const std::vector<AABB>& primitiveBounds) const noexcept;
+
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_primitiveIndices;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <string_view>
+
+namespace Platform
+{
+	// Everything Application needs from the platform: a thread that waits for finished
+	// frames and somewhere to show them. Run() blocks the thread that calls it,
+	// Notify() and Quit() may be called from any thread
+	class Backend
+	{
+	public:
+		virtual ~Backend() = default;
+
+		// returns once Quit() was called or the user closed the display, onNotify
+		// runs on the calling thread at least once after every Notify()
+		virtual void Run(const std::function<void()>& onNotify) = 0;
+		virtual void Notify() noexcept = 0;
+		virtual void Quit() noexcept = 0;
+
+		// only called from onNotify, frames are tightly packed 24 bit BGR rows
+		virtual void Present(const uint8_t* bgr, uint16_t width, uint16_t height) noexcept = 0;
+		virtual void SetTitle(std::wstring_view title) noexcept = 0;
+	};
+
+	// No display, frames are dropped and offline callers read the accumulation once
+	// Start() returns. Titles can be echoed to stdout as progress output
+	class HeadlessBackend final : public Backend
+	{
+	public:
+		explicit HeadlessBackend(bool printTitles = false) noexcept : m_printTitles(printTitles) {}
+
+		void Run(const std::function<void()>& onNotify) override
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (true)
+			{
+				m_wake.wait(lock, [this] { return m_notified || m_quit; });
+				if (m_quit)
+				{
+					return;
+				}
+				m_notified = false;
+
+				lock.unlock();
+				onNotify();
+				lock.lock();
+			}
+		}
+
+		void Notify() noexcept override
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_notified = true;
+			}
+			m_wake.notify_one();
+		}
+
+		void Quit() noexcept override
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_quit = true;
+			}
+			m_wake.notify_one();
+		}
+
+		void Present(const uint8_t*, uint16_t, uint16_t) noexcept override {}
+
+		void SetTitle(std::wstring_view title) noexcept override
+		{
+			if (m_printTitles)
+			{
+				// titles are plain ASCII
+				const std::string narrow(title.begin(), title.end());
+				printf("%s\n", narrow.c_str());
+				fflush(stdout);
+			}
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		bool m_notified = false;
+		bool m_quit = false;
+		bool m_printTitles;
+	};
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define CAMERA_H
 
 #include "Ray.h"
+#include "Sampler.h"
 
 struct Camera
 {
@@ -23,11 +24,19 @@ public:
 	}
 
 
-	Ray GetRay(float s, float t) const noexcept
+	// The multiply-adds are explicit so every caller computes the same ray: left to the
+	// compiler, they contract differently wherever the function is inlined, and the
+	// packet and single ray paths would start from rays a rounding apart
+	Ray GetRay(float s, float t, Sampler& sampler) const noexcept
 	{
-		const Vec3f rd = lensRadius * RandomInUnitDisk();
-		const Vec3f offset = u * rd.x + v * rd.y;
-		return Ray(origin + offset, lowerLeftCorner + s * horizontal + t * vertical - origin - offset );
+		const Vec3f rd = lensRadius * SampleInUnitDisk(sampler);
+		const Vec3f offset = MulAdd(v, rd.y, u * rd.x);
+		return Ray(origin + offset, MulAdd(vertical, t, MulAdd(horizontal, s, lowerLeftCorner)) - origin - offset);
+	}
+
+	static Vec3f MulAdd(const Vec3f& a, float b, const Vec3f& c) noexcept
+	{
+		return Vec3f(fmaf(a.x, b, c.x), fmaf(a.y, b, c.y), fmaf(a.z, b, c.z));
 	}
 
 	Vec3f origin;
@@ -0,0 +1,54 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstring>
+
+// Layout of a checkpoint file: this header, then the accumulation (RGB sums), the
+// squared luminance sums and the per pixel sample counts, exactly as the renderer
+// keeps them in memory, so the render accumulates straight into the mapping
+struct alignas(64) CheckpointHeader
+{
+	static constexpr char MAGIC[8] = { 'R', 'T', 'C', 'K', 'P', 'T', '\0', '\0' };
+	static constexpr uint32_t VERSION = 1;
+
+	char magic[8];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved;
+	uint64_t sceneHash;   // scene and estimator settings, a mismatch means the samples are not comparable
+	uint64_t sampleIndex; // next frame's sample index
+	uint64_t rngState;    // sampler state, the per pixel sample counts carry the rest
+	uint64_t frameIndex;
+
+	bool Matches(uint32_t Width, uint32_t Height, uint64_t SceneHash) const noexcept
+	{
+		return memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 && version == VERSION && width == Width && height == Height && sceneHash == SceneHash;
+	}
+
+	static size_t FileSize(size_t width, size_t height) noexcept
+	{
+		const size_t pixels = width * height;
+		return sizeof(CheckpointHeader) + pixels * (3 * sizeof(float) + sizeof(float) + sizeof(uint32_t));
+	}
+};
+
+// FNV-1a, used to fingerprint scenes for checkpoints
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ull) noexcept
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+template <typename T>
+inline uint64_t HashValue(const T& value, uint64_t hash) noexcept
+{
+	return HashBytes(&value, sizeof(T), hash);
+}
+
+#endif
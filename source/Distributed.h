@@ -0,0 +1,169 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "Raytracer.h"
+#include "Socket.h"
+
+// Multi-process rendering. The coordinator cuts the frame into jobs (a tile times a
+// range of sample indices) and hands them to worker processes over TCP, one job per
+// idle worker, so faster workers simply get more of them. Samples are a pure function
+// of (pixel, sample index), so partial accumulations of disjoint sample ranges add up
+// to exactly the buffers one process would have accumulated. A worker that dies, or
+// hangs past the handshake or job deadline, is dropped and gives its job back to the
+// queue; one that is much slower than the average gets its job duplicated on an idle
+// worker once the queue ran dry, the first result wins
+namespace DISTRIBUTED
+{
+	static constexpr uint32_t PROTOCOL_MAGIC = 0x50445452; // "RTDP"
+	static constexpr uint32_t PROTOCOL_VERSION = 1;
+
+	// Every message is a header followed by size payload bytes. Fields are sent in
+	// host byte order, coordinator and workers are expected to be little endian
+	enum class MessageType : uint32_t
+	{
+		HELLO = 1, // worker -> coordinator: Hello
+		CONFIG,    // coordinator -> worker: Config
+		READY,     // worker -> coordinator: Ready
+		JOB,       // coordinator -> worker: Job
+		RESULT,    // worker -> coordinator: ResultHeader, RGB sums, squared luminance sums, counts
+		SHUTDOWN,  // coordinator -> worker: nothing
+	};
+
+	struct MessageHeader
+	{
+		uint32_t type;
+		uint32_t size;
+	};
+
+	struct Hello
+	{
+		uint32_t magic;
+		uint32_t version;
+	};
+
+	struct Config
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t sampler;
+		uint32_t accelerationStructure;
+		int32_t maxDepth;
+		int32_t rouletteStartDepth;
+		uint64_t identity; // RaytracingInAWeekend::SampleIdentity(), workers with another scene refuse
+	};
+
+	struct Ready
+	{
+		uint32_t accepted;
+	};
+
+	struct Job
+	{
+		uint32_t id;
+		uint32_t x0;
+		uint32_t y0;
+		uint32_t width;
+		uint32_t height;
+		uint32_t sampleBegin;
+		uint32_t sampleCount;
+	};
+
+	struct ResultHeader
+	{
+		uint32_t id;
+		uint32_t pixelCount;
+		uint64_t rays;
+	};
+
+	bool WriteMessage(Socket& socket, MessageType type, const void* payload, uint32_t size) noexcept;
+	bool ReadHeader(Socket& socket, MessageHeader& header) noexcept;
+
+	// Connects to host:port (retrying while the coordinator starts up), renders jobs
+	// until told to shut down. Returns the process exit code
+	int RunWorker(const char* host, uint16_t port, size_t threadCount, bool verbose);
+};
+
+class Coordinator
+{
+public:
+	// the reference raytracer provides the settings sent to workers and the identity they must match
+	Coordinator(const RaytracingInAWeekend& reference, uint32_t width, uint32_t height, uint32_t samplesPerPixel, uint32_t jobTileSize, uint32_t jobSamples);
+
+	// port 0 picks a free one, see Port()
+	bool Listen(uint16_t port) noexcept;
+	uint16_t Port() const noexcept { return m_listener.LocalPort(); }
+
+	// Serves workers until every job is merged. A connection that has not finished the
+	// handshake within workerTimeoutSeconds, or a worker still on a job after
+	// jobTimeoutSeconds, is dropped. Fails if no worker was ready for
+	// workerTimeoutSeconds in a row
+	bool Run(float workerTimeoutSeconds, float jobTimeoutSeconds, bool verbose);
+
+	bool WriteImage(const char* path) const;
+
+	uint64_t RaysTraced() const noexcept { return m_raysTraced; }
+	uint64_t PathsTraced() const noexcept { return m_pathsTraced; }
+	size_t JobCount() const noexcept { return m_jobs.size(); }
+	size_t ReassignedJobs() const noexcept { return m_reassigned; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Worker
+	{
+		Socket socket;
+		bool ready = false;
+		Clock::time_point connected;
+		int64_t job = -1;
+		Clock::time_point jobStart;
+		uint32_t jobsDone = 0;
+	};
+
+	bool HandleMessage(Worker& worker);
+	void AssignJobs(std::vector<std::unique_ptr<Worker>>& workers);
+	void ReleaseJob(Worker& worker);
+	void Merge(const DISTRIBUTED::Job& job, const float* sums, const float* luminanceSquared, const uint32_t* counts) noexcept;
+
+	DISTRIBUTED::Config m_config;
+	Socket m_listener;
+
+	std::vector<DISTRIBUTED::Job> m_jobs;
+	std::vector<uint8_t> m_jobDone;
+	std::vector<uint8_t> m_jobCopies; // workers currently rendering the job
+	std::deque<uint32_t> m_queue;
+	size_t m_jobsDone = 0;
+	size_t m_reassigned = 0;
+	double m_jobSecondsTotal = 0.0;
+
+	std::vector<float> m_accumulation;
+	std::vector<float> m_luminanceSquared;
+	std::vector<uint32_t> m_sampleCounts;
+	std::vector<uint8_t> m_receiveBuffer;
+	uint64_t m_raysTraced = 0;
+	uint64_t m_pathsTraced = 0;
+};
+
+// Worker processes of this executable connected to a local coordinator
+class LocalWorkers
+{
+public:
+	~LocalWorkers() { Wait(0.0f); }
+
+	bool Spawn(const char* executable, uint16_t port, size_t count, size_t threadsPerWorker);
+	// Waits up to timeoutSeconds for every spawned worker to exit and kills the rest,
+	// a hung worker was already replaced by the coordinator and must not hold it up
+	void Wait(float timeoutSeconds) noexcept;
+
+private:
+#ifdef _WIN32
+	std::vector<void*> m_processes;
+#else
+	std::vector<int> m_processes;
+#endif
+};
+
+#endif
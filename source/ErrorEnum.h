@@ -9,6 +9,8 @@ enum class RESULT_VALUE : uint8_t
 	GENERIC_ERROR,
 	ALLOCATOR_NOT_INITIALIZED,
 	ERROR_DOUBLE_FREE,
+	CHECKPOINT_OPEN_FAILED,
+	CHECKPOINT_MISMATCH,
 };
 
 #endif
\ No newline at end of file
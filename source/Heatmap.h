@@ -0,0 +1,54 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include "NaiveMath.h"
+#include "Stats.h"
+#include <algorithm>
+
+// Debug views replace a pixel's color by the mean cost of its samples, shown as a
+// false color heatmap. The samples are the production ones, same sampler sequence and
+// tile scheduling, but always traced one ray at a time by the megakernel: the wavefront
+// and packet paths do not count per path, so a heatmap measures the single ray cost
+enum class DebugView : uint8_t
+{
+	NONE,
+	PRIMITIVE_TESTS, // ray/primitive intersection tests per sample, needs RT_STATS
+	BVH_NODES,       // BVH nodes visited per sample, needs RT_STATS
+	PATH_LENGTH,     // path segments traced per sample, light sampling's shadow rays excluded
+};
+
+inline const char* DebugViewName(DebugView view) noexcept
+{
+	switch (view)
+	{
+		case DebugView::PRIMITIVE_TESTS: return "Primitive tests";
+		case DebugView::BVH_NODES: return "BVH nodes";
+		case DebugView::PATH_LENGTH: return "Path length";
+		default: return "None";
+	}
+}
+
+// the intersection counts come from the hot path counters, which are compiled out otherwise
+constexpr bool DebugViewAvailable(DebugView view) noexcept
+{
+	return STATS::ENABLED || view == DebugView::NONE || view == DebugView::PATH_LENGTH;
+}
+
+// t in [0, 1] through black, blue, cyan, green, yellow, red to white, values above
+// the scale saturate to white
+inline Vec3f HeatColor(float t) noexcept
+{
+	static constexpr float stops[7][3] =
+	{
+		{ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 1.0f }, { 0.0f, 1.0f, 0.0f },
+		{ 1.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f },
+	};
+	const float position = fminf(fmaxf(t, 0.0f), 1.0f) * 6.0f;
+	const int stop = std::min(static_cast<int>(position), 5);
+	const float f = position - static_cast<float>(stop);
+	return Vec3f(stops[stop][0] + f * (stops[stop + 1][0] - stops[stop][0]),
+		stops[stop][1] + f * (stops[stop + 1][1] - stops[stop][1]),
+		stops[stop][2] + f * (stops[stop + 1][2] - stops[stop][2]));
+}
+
+#endif
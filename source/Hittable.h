@@ -5,16 +5,29 @@
 #include "Ray.h"
 #include "Random.h"
 #include "Material.h"
+#include "AABB.h"
 
 struct HitRegistry;
 
+// Adapter interface for user-defined shapes, see Scene::AddHittable. Built-in
+// primitives live in packed per-type arrays and don't go through the vtable
 class Hittable
 {
 public:
 	virtual bool HIT(const Ray& r, HitRegistry* rec, float t_min = 0, float t_max = 10000.0f) const noexcept = 0;
+	virtual AABB BoundingBox() const noexcept = 0;
+
+	// any hit inside (t_min, t_max), for shadow and visibility rays. Shapes that can
+	// answer without building a hit record should override it
+	virtual bool Occluded(const Ray& r, float t_min, float t_max) const noexcept
+	{
+		HitRegistry rec;
+		return HIT(r, &rec, t_min, t_max);
+	}
+
 	virtual ~Hittable() {};
 
-	Material material;
+	MaterialID materialID = 0;
 };
 
 #endif
\ No newline at end of file
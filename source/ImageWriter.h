@@ -0,0 +1,87 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string_view>
+#include <vector>
+
+enum class ImageFormat : uint8_t
+{
+	PPM, // binary 8 bit RGB
+	PNG, // 8 bit RGB, stored (uncompressed) deflate
+	PFM, // 32 bit float RGB, linear
+};
+
+// picks the format from the file extension, PPM when there is none it knows
+ImageFormat ImageFormatFromPath(std::string_view path) noexcept;
+
+// Writes an image piece by piece as tiles or scanlines finish. Pixels come in as
+// accumulated RGB sums plus per pixel sample counts, i.e. straight from the
+// accumulation buffer, so no averaged copy of the frame is ever made. PPM and PFM
+// rows have a fixed size and are written in place in any order, PNG rows have to be
+// written top to bottom, so tiles below an incomplete row are held back as 8 bit
+// rows until the rows above them are complete
+class ImageWriter
+{
+public:
+	ImageWriter() = default;
+	~ImageWriter();
+
+	ImageWriter(const ImageWriter&) = delete;
+	ImageWriter& operator=(const ImageWriter&) = delete;
+
+	bool Open(const char* path, ImageFormat format, uint32_t width, uint32_t height);
+
+	// sums holds tileHeight rows of tileWidth RGB sums, sumStride floats apart. counts
+	// holds the matching sample counts countStride apart, nullptr if sums are averages
+	bool WriteTile(uint32_t x0, uint32_t y0, uint32_t tileWidth, uint32_t tileHeight, const float* sums, size_t sumStride, const uint32_t* counts, size_t countStride);
+
+	// full width rows starting at row y0
+	bool WriteRows(uint32_t y0, uint32_t rows, const float* sums, const uint32_t* counts)
+	{
+		return WriteTile(0, y0, m_width, rows, sums, static_cast<size_t>(m_width) * 3, counts, m_width);
+	}
+
+	// fails if a PNG is missing rows or anything failed to write
+	bool Close();
+
+	bool IsOpen() const noexcept { return m_file != nullptr; }
+
+private:
+	struct PendingRow
+	{
+		std::vector<uint8_t> pixels;
+		uint32_t written = 0;
+	};
+
+	bool Seek(uint64_t offset) noexcept;
+	void Write(const void* data, size_t size) noexcept;
+
+	void WritePNGRow(const uint8_t* pixels) noexcept;
+	void WritePNGData(const uint8_t* data, size_t size) noexcept;
+	void WriteChunkBytes(const void* data, size_t size) noexcept;
+	void BeginPNGChunk(const char* type, uint32_t length) noexcept;
+	void EndPNGChunk() noexcept;
+
+	FILE* m_file = nullptr;
+	ImageFormat m_format = ImageFormat::PPM;
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	uint64_t m_dataOffset = 0;
+	bool m_ok = false;
+	std::vector<uint8_t> m_rowScratch;
+
+	// PNG stream state, every stored deflate block goes into its own IDAT chunk
+	std::map<uint32_t, PendingRow> m_pendingRows;
+	uint32_t m_nextRow = 0;
+	uint64_t m_deflateTotal = 0;
+	uint64_t m_deflateRemaining = 0;
+	uint32_t m_blockRemaining = 0;
+	uint32_t m_crc = 0;
+	uint32_t m_adlerA = 1;
+	uint32_t m_adlerB = 0;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Read/write shared mapping of a whole file. Stores into the mapping reach the OS
+// page cache right away, so they survive the process dying, Flush() additionally
+// pushes them to disk
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Maps path, creating it zero filled with the given size if it does not exist.
+	// existed tells whether the file was already there, an existing file of another
+	// size is not touched and fails
+	bool Open(const char* path, size_t size, bool& existed);
+	void Close() noexcept;
+	bool Flush() noexcept;
+
+	void* Data() const noexcept { return m_data; }
+	size_t Size() const noexcept { return m_size; }
+	bool IsOpen() const noexcept { return m_data != nullptr; }
+
+private:
+	void* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_file = -1;
+#endif
+};
+
+#endif
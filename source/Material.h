@@ -2,17 +2,23 @@
 #define MATERIAL_H
 
 #include "Ray.h"
-#include "Random.h"
+#include "Sampler.h"
 
 struct HitRegistry;
 
+// index into the scene material table, see Scene::AddMaterial
+using MaterialID = uint32_t;
+
 enum class MaterialType : uint8_t
 {
 	LAMBERTIAN,
 	METALLIC,
 	DIELECTRIC,
+	EMISSIVE,   // a light, emits Emission and ends the path
 };
 
+inline constexpr size_t MATERIAL_TYPE_COUNT = 4;
+
 class Material
 {
 public:
@@ -37,8 +43,33 @@ public:
 		Fuzz = fminf(fuzz, 1.0f);
 	}
 
-	bool Scatter(const Ray& In, HitRegistry* rec, Vec3f& attenuation, Ray& scattered) const noexcept;
+	void SetEmissive(const Vec3f& radiance) noexcept
+	{
+		type = MaterialType::EMISSIVE;
+		Albedo = Vec3f(0.0f, 0.0f, 0.0f);
+		Emission = radiance;
+	}
+
+	// Lambertian rays leave along normal + a point in the unit ball, a direction density
+	// of 2 cos^3 / pi around the normal. Scatter weights them by the albedo alone, so
+	// the BSDF times cosine rendered is Albedo * LambertianPdf, which light sampling
+	// evaluates for its directions. direction is a unit vector
+	static float LambertianPdf(const Vec3f& normal, const Vec3f& direction) noexcept
+	{
+		const float cosine = dot(normal, direction);
+		return cosine > 0.0f ? 0.636619772f * cosine * cosine * cosine : 0.0f;
+	}
+
+	bool Scatter(const Ray& In, HitRegistry* rec, Vec3f& attenuation, Ray& scattered, Sampler& sampler) const noexcept;
+
+	// Per type kernels Scatter switches over, inline so loops over a batch of one
+	// material type (see Wavefront.h) compile to branch free straight line code
+	bool ScatterLambertian(const HitRegistry& rec, Vec3f& attenuation, Ray& scattered, Sampler& sampler) const noexcept;
+	bool ScatterMetallic(const Ray& In, const HitRegistry& rec, Vec3f& attenuation, Ray& scattered, Sampler& sampler) const noexcept;
+	bool ScatterDielectric(const Ray& In, const HitRegistry& rec, Vec3f& attenuation, Ray& scattered, Sampler& sampler) const noexcept;
+
 	Vec3f Albedo;
+	Vec3f Emission = Vec3f(0.0f, 0.0f, 0.0f);
 	float ScatterChance = 0.2f;
 	float Fuzz = 1.0f;
 	float RefractionIndex = 1.0f;
@@ -47,11 +78,69 @@ public:
 
 struct HitRegistry
 {
+	static constexpr uint32_t NO_SPHERE = UINT32_MAX;
+
 	constexpr HitRegistry() {}
 
 	float t = -1;
 	vec3 p = { 0,0,0 };
 	vec3 normal = { 0,0,0 };
-	Material material;
+	MaterialID materialID = 0;
+	uint32_t sphere = NO_SPHERE; // index in the scene's SphereSet, NO_SPHERE for custom shapes
 };
+
+inline bool Material::ScatterLambertian(const HitRegistry& rec, Vec3f& attenuation, Ray& scattered, Sampler& sampler) const noexcept
+{
+	scattered = Ray(rec.p, (rec.p + rec.normal + SampleInUnitSphere(sampler)) - rec.p);
+	attenuation = Albedo;
+	return true;
+}
+
+inline bool Material::ScatterMetallic(const Ray& In, const HitRegistry& rec, Vec3f& attenuation, Ray& scattered, Sampler& sampler) const noexcept
+{
+	const Vec3f reflected = reflect(unit_vector(In.direction), rec.normal);
+	scattered = Ray(rec.p, reflected + Fuzz * SampleInUnitSphere(sampler));
+	attenuation = Albedo;
+	return (dot(scattered.direction, rec.normal) > 0);
+}
+
+inline bool Material::ScatterDielectric(const Ray& In, const HitRegistry& rec, Vec3f& attenuation, Ray& scattered, Sampler& sampler) const noexcept
+{
+	Vec3f outwardNormal;
+	Vec3f refracted;
+	Vec3f reflected = reflect(In.direction, rec.normal);
+	float refractiveIndexRatio;
+	attenuation = {1.0f, 1.0f, 1.0f};
+	float reflectProbability = 1.0f;
+	float cosine;
+
+	if (dot(In.direction, rec.normal) > 0)
+	{
+		outwardNormal = -rec.normal;
+		refractiveIndexRatio = RefractionIndex;
+		cosine = RefractionIndex * dot(In.direction, rec.normal) / In.direction.length();
+	}
+	else
+	{
+		outwardNormal = rec.normal;
+		refractiveIndexRatio = 1.0f / RefractionIndex;
+		cosine = -dot(In.direction, rec.normal) / In.direction.length();
+	}
+
+	if (refract(In.direction, outwardNormal, refractiveIndexRatio, refracted))
+	{
+		reflectProbability = schlick(cosine, RefractionIndex);
+	}
+
+	if (sampler.Next() < reflectProbability)
+	{
+		scattered = Ray(rec.p, reflected);
+	}
+	else
+	{
+		scattered = Ray(rec.p, refracted);
+	}
+
+	return true;
+}
 #endif
@@ -0,0 +1,69 @@
+#ifndef MATH_BENCH_H
+#define MATH_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Shared harness of the Maths.h vs NaiveMath.h microbenchmarks. Both headers define a
+// Vec3f, so each library's kernels live in their own translation unit and only plain
+// float arrays cross between them
+
+namespace MATH_BENCH
+{
+	static constexpr size_t COUNT = 4096;   // inputs per pass, small enough to stay in L1/L2
+	static constexpr size_t MATRICES = 256;
+	static constexpr int REPETITIONS = 9;   // the fastest pass is reported
+
+	// xyz triples unless noted otherwise
+	struct Data
+	{
+		std::vector<float> a;          // arbitrary vectors
+		std::vector<float> b;          // arbitrary vectors
+		std::vector<float> normals;    // unit vectors facing against a
+		std::vector<float> scalars;    // positive values, cosines in [0, 1] for Schlick
+		std::vector<float> ratios;     // refractive index ratios
+		std::vector<float> matrices;   // MATRICES row-major 4x4, well conditioned
+		std::vector<float> origins;    // ray origins
+		std::vector<float> directions; // ray directions
+		std::vector<float> centers;    // sphere centers, one sphere per ray
+		std::vector<float> radii;
+	};
+
+	struct Result
+	{
+		const char* kernel;
+		const char* implementation;
+		double nanoseconds; // per operation
+		double checksum;    // sum of the outputs, implementations of a kernel should agree
+	};
+
+	// keeps the compiler from discarding the kernels' results
+	inline volatile float sink = 0.0f;
+
+	// kernel() runs one pass of operations independent operations and returns a
+	// checksum of its outputs, so this measures throughput rather than latency
+	template <typename Kernel>
+	Result Measure(const char* kernel, const char* implementation, size_t operations, Kernel&& pass)
+	{
+		double best = 1e30;
+		float checksum = 0.0f;
+		for (int repetition = 0; repetition < REPETITIONS; ++repetition)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			checksum = pass();
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			sink = sink + checksum;
+			best = std::min(best, seconds);
+		}
+		return { kernel, implementation, best / static_cast<double>(operations) * 1e9, static_cast<double>(checksum) };
+	}
+
+	// NaiveMath.h, plus a plain float[16] matrix as it has none
+	void RunScalar(const Data& data, std::vector<Result>& results);
+	// Maths.h, plus refract, Schlick and the sphere test written with its types as it has none
+	void RunSimd(const Data& data, std::vector<Result>& results);
+};
+
+#endif
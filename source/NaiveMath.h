@@ -1,13 +1,14 @@
 #ifndef NAIVE_MATH_H
 #define NAIVE_MATH_H
 
-#include <corecrt_math.h>
+#include <cmath>
 #include <iostream>
 
 struct Vec3f
 {
 	constexpr Vec3f() : x(0), y(0), z(0) {}
 	constexpr Vec3f(const Vec3f& other) : x(other.x), y(other.y), z(other.z){}
+	constexpr Vec3f& operator=(const Vec3f& other) = default;
 	constexpr Vec3f(float X, float Y, float Z) : x(X), y(Y), z(Z) {}
 
 	union
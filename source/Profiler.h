@@ -0,0 +1,127 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Scoped timing spans for chrome://tracing and Perfetto. Every thread records into
+// its own ring buffer, written only by that thread with a release store of the
+// head, so recording never locks or waits and a full ring overwrites its oldest
+// spans. Off until Enable(), a disabled span costs one relaxed load
+namespace PROFILER
+{
+	struct Event
+	{
+		const char* name;   // string literal, kept by pointer
+		uint64_t begin;     // steady clock nanoseconds
+		uint64_t end;
+		uint32_t thread;    // track the span is drawn on, usually the recording thread's
+		uint32_t items;     // optional "items" argument, 0 leaves it out
+		const char* metric; // optional named argument, nullptr leaves it out
+		double value;
+	};
+
+	class ThreadTrace
+	{
+	public:
+		ThreadTrace(uint32_t id, size_t capacity);
+
+		void Record(const Event& event) noexcept
+		{
+			const uint64_t head = m_head.load(std::memory_order_relaxed);
+			m_events[head & m_mask] = event;
+			m_head.store(head + 1, std::memory_order_release);
+		}
+
+		uint32_t Id() const noexcept { return m_id; }
+
+		// the retained spans, oldest first. Spans being overwritten meanwhile may be
+		// torn, so read once the recording threads are quiet
+		template <typename Visit>
+		void ForEach(Visit&& visit) const
+		{
+			const uint64_t head = m_head.load(std::memory_order_acquire);
+			const uint64_t first = head > m_mask + 1 ? head - (m_mask + 1) : 0;
+			for (uint64_t i = first; i < head; ++i)
+			{
+				visit(m_events[i & m_mask]);
+			}
+		}
+
+		std::string name;
+
+	private:
+		std::unique_ptr<Event[]> m_events;
+		uint64_t m_mask;
+		std::atomic<uint64_t> m_head = 0;
+		uint32_t m_id;
+	};
+
+	inline std::atomic<bool> s_enabled = false;
+
+	// eventsPerThread is rounded up to a power of two and applies to threads that
+	// record their first span afterwards
+	void Enable(size_t eventsPerThread = 1 << 16);
+	void Disable() noexcept;
+	inline bool Enabled() noexcept { return s_enabled.load(std::memory_order_relaxed); }
+
+	inline uint64_t Timestamp(std::chrono::steady_clock::time_point time) noexcept
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+	}
+
+	inline uint64_t Now() noexcept
+	{
+		return Timestamp(std::chrono::steady_clock::now());
+	}
+
+	// the calling thread's ring, registered on first use and kept for the process lifetime
+	ThreadTrace& RegisterThread();
+	inline thread_local ThreadTrace* t_trace = nullptr;
+
+	inline ThreadTrace& Local()
+	{
+		return t_trace ? *t_trace : RegisterThread();
+	}
+
+	// names the calling thread's track, cheap enough to call from threads that never record
+	void SetThreadName(const char* name);
+
+	// every retained span as Chrome trace-event JSON, spans in microseconds from the earliest one
+	bool WriteChromeTrace(const char* path);
+
+	class Scope
+	{
+	public:
+		explicit Scope(const char* name, uint32_t items = 0) noexcept
+			: m_name(name), m_begin(Enabled() ? Now() : 0), m_items(items)
+		{
+		}
+
+		~Scope()
+		{
+			if (m_begin)
+			{
+				ThreadTrace& trace = Local();
+				trace.Record({ m_name, m_begin, Now(), trace.Id(), m_items, nullptr, 0.0 });
+			}
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char* m_name;
+		uint64_t m_begin;
+		uint32_t m_items;
+	};
+};
+
+#define RT_PROFILE_CONCAT_(a, b) a##b
+#define RT_PROFILE_CONCAT(a, b) RT_PROFILE_CONCAT_(a, b)
+#define RT_PROFILE_SCOPE(...) PROFILER::Scope RT_PROFILE_CONCAT(profileScope, __LINE__)(__VA_ARGS__)
+
+#endif
@@ -1,18 +1,24 @@
 #ifndef RT_WINDOW_H
 #define RT_WINDOW_H
 
-#define NO_MIN_MAX
+#ifdef _WIN32
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #define WIN32_LEAN_AND_MEAN
 
 #include "Windows.h"
 #include <iostream>
+#include "Backend.h"
 
-class Application;
 namespace Platform
 {
+	class Win32Backend;
+
 	class Window
 	{
-		friend class Application;
+		friend class Win32Backend;
 	public:
 		explicit Window(uint16_t Width = 800, uint16_t Height = 600, std::wstring_view windowName = L"Default Window");
 
@@ -22,9 +28,34 @@ namespace Platform
 		HINSTANCE m_hInstance = nullptr;
 		HWND m_hwnd = nullptr;
 		HDC m_hdc = nullptr;
+		const std::function<void()>* m_onNotify = nullptr; // set while Win32Backend::Run pumps messages
+
+		static constexpr UINT WM_RT_NOTIFY = WM_APP + 1;
+		static constexpr UINT WM_RT_QUIT = WM_APP + 2;
 
 		static LRESULT CALLBACK MsgHandling(_In_ HWND hWnd, _In_ UINT Msg, _In_ WPARAM wParam, _In_ LPARAM lParam);
 	};
+
+	// GDI window, Run() is the message pump and frames are blitted with SetDIBitsToDevice.
+	// Notifications and Quit() are posted to the window rather than the thread, so the
+	// modal loops of a window drag or resize still dispatch them instead of dropping them
+	class Win32Backend final : public Backend
+	{
+	public:
+		Win32Backend(uint16_t width, uint16_t height, std::wstring_view windowName);
+		~Win32Backend() override;
+
+		void Run(const std::function<void()>& onNotify) override;
+		void Notify() noexcept override;
+		void Quit() noexcept override;
+		void Present(const uint8_t* bgr, uint16_t width, uint16_t height) noexcept override;
+		void SetTitle(std::wstring_view title) noexcept override;
+
+	private:
+		Window m_window;
+	};
 };
 
-#endif
\ No newline at end of file
+#endif
+
+#endif
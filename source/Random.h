@@ -2,7 +2,6 @@
 #define RANDOM_H
 
 #include <random>
-#include <intrin.h>
 #include <climits>
 #include "NaiveMath.h"
 
@@ -24,43 +23,40 @@ namespace RANDOM
         return (word >> 22u) ^ word;
     }
 
+    // maps a 32 bit hash to [0, 1) using its top 24 bits, exact in a float mantissa
+    [[maybe_unused]] inline static float ToUnitFloat(uint32_t value) noexcept
+    {
+        return static_cast<float>(value >> 8) * (1.0f / 16777216.0f);
+    }
+
     [[maybe_unused]] inline static float RandomValue(uint32_t value) noexcept
     {
-        static constexpr float min = 1.0f / (float)UINT32_MAX + 1u;
-        return (float)PCG_Hash(value) * min;
+        return ToUnitFloat(PCG_Hash(value));
+    }
+
+    // Combines the sample coordinates into a single well mixed 32 bit value, one
+    // PCG round per coordinate
+    [[maybe_unused]] inline static uint32_t CounterHash(uint32_t pixel, uint32_t sample, uint32_t bounce, uint32_t dimension) noexcept
+    {
+        return PCG_Hash(dimension ^ PCG_Hash(bounce ^ PCG_Hash(sample ^ PCG_Hash(pixel))));
     }
 
-    inline thread_local std::default_random_engine generator = {};
+    // minstd_rand and the mapping below are fully specified, unlike default_random_engine and
+    // uniform_real_distribution, so a seed produces the same scene with every standard library
+    inline thread_local std::minstd_rand generator = {};
 
+    inline void SeedScene(uint32_t seed) noexcept
+    {
+        generator.seed(seed ? seed : std::minstd_rand::default_seed);
+    }
+
+    // Scene setup only, the render path draws its numbers from Sampler (Sampler.h)
     template <typename NumericType = float>
     [[nodiscard]] inline static float RandomInterval(NumericType min = 0.0f, NumericType max = 0.999999f) noexcept
     {
-        static std::uniform_real_distribution<NumericType> toReturn(min, max);
-        return toReturn(generator);
+        const double unit = static_cast<double>(generator() - std::minstd_rand::min()) / static_cast<double>(std::minstd_rand::max() - std::minstd_rand::min() + 1);
+        return static_cast<float>(min + (max - min) * unit);
     };
 };
 
-inline Vec3f RandomInUnitSphere() noexcept
-{
-    //static uint32_t value = 0xdeadbeef;
-    //RANDOM::RandomValue(value)
-    Vec3f p;
-    do
-    {
-        //++value;
-        p = 2.0f * Vec3f(RANDOM::RandomInterval(), RANDOM::RandomInterval(), RANDOM::RandomInterval()) - Vec3f(1, 1, 1);
-    } while (p.squared_length() >= 1.0f);
-    return p;
-}
-
-inline Vec3f RandomInUnitDisk() noexcept
-{
-    Vec3f p;
-    do
-    {
-        p = 2.0f * Vec3f(RANDOM::RandomInterval(), RANDOM::RandomInterval(), RANDOM::RandomInterval()) - Vec3f(1.0f, 1.0f, 0.0f);
-    } while (dot(p,p) >= 1.0f);
-    return p;
-}
-
 #endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include <bit>
+#include <cstdint>
+#include <cfloat>
+#include <immintrin.h>
+#include "AABB.h"
+
+#if defined(__AVX2__)
+#define RAY_PACKETS 1
+#else
+#define RAY_PACKETS 0
+#endif
+
+// Eight coherent rays, one per AVX2 lane, stored per component so every node and
+// primitive test runs on all of them at once. Camera rays of a 4x2 pixel block
+// start out nearly parallel, later bounces are traced one by one
+struct alignas(32) RayPacket
+{
+	static constexpr uint32_t SIZE = 8;
+
+	// primitive index in a lane that a custom shape already wrote the hit record of
+	static constexpr int32_t CUSTOM_HIT = -2;
+
+	float originX[SIZE], originY[SIZE], originZ[SIZE];
+	float directionX[SIZE], directionY[SIZE], directionZ[SIZE];
+	float inverseX[SIZE], inverseY[SIZE], inverseZ[SIZE];
+	float tMax[SIZE];      // closest hit so far, shrinks during traversal
+	int32_t sphere[SIZE];  // nearest sphere, -1 for none
+	uint32_t activeMask = 0;
+
+	void Set(uint32_t lane, const Ray& r, float t_max) noexcept
+	{
+		const Vec3f inverse = SafeInverse(r.direction);
+		originX[lane] = r.origin.x; originY[lane] = r.origin.y; originZ[lane] = r.origin.z;
+		directionX[lane] = r.direction.x; directionY[lane] = r.direction.y; directionZ[lane] = r.direction.z;
+		inverseX[lane] = inverse.x; inverseY[lane] = inverse.y; inverseZ[lane] = inverse.z;
+		tMax[lane] = t_max;
+		sphere[lane] = -1;
+		activeMask |= 1u << lane;
+	}
+
+	// idle lanes copy an active one so their math stays finite, their mask bit stays off
+	void Finish() noexcept
+	{
+		const uint32_t source = static_cast<uint32_t>(std::countr_zero(activeMask));
+		for (uint32_t lane = 0; lane < SIZE; ++lane)
+		{
+			if (!(activeMask & (1u << lane)))
+			{
+				originX[lane] = originX[source]; originY[lane] = originY[source]; originZ[lane] = originZ[source];
+				directionX[lane] = directionX[source]; directionY[lane] = directionY[source]; directionZ[lane] = directionZ[source];
+				inverseX[lane] = inverseX[source]; inverseY[lane] = inverseY[source]; inverseZ[lane] = inverseZ[source];
+				tMax[lane] = -FLT_MAX;
+				sphere[lane] = -1;
+			}
+		}
+	}
+
+#if RAY_PACKETS
+	// Slab test of every lane against the box with its own t range, returns the lanes
+	// that hit and the nearest entry among them
+	uint32_t Intersect(const AABB& box, float t_min, float& nearestEntry) const noexcept
+	{
+		const __m256 ox = _mm256_load_ps(originX), oy = _mm256_load_ps(originY), oz = _mm256_load_ps(originZ);
+		const __m256 ix = _mm256_load_ps(inverseX), iy = _mm256_load_ps(inverseY), iz = _mm256_load_ps(inverseZ);
+
+		const __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.min.x), ox), ix);
+		const __m256 tx2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.max.x), ox), ix);
+		const __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.min.y), oy), iy);
+		const __m256 ty2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.max.y), oy), iy);
+		const __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.min.z), oz), iz);
+		const __m256 tz2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.max.z), oz), iz);
+
+		__m256 tNear = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx1, tx2), _mm256_min_ps(ty1, ty2)), _mm256_min_ps(tz1, tz2));
+		__m256 tFar = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx1, tx2), _mm256_max_ps(ty1, ty2)), _mm256_max_ps(tz1, tz2));
+		tNear = _mm256_max_ps(tNear, _mm256_set1_ps(t_min));
+		tFar = _mm256_min_ps(tFar, _mm256_load_ps(tMax));
+
+		const __m256 hit = _mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ);
+		const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(hit)) & activeMask;
+		if (mask)
+		{
+			// horizontal min of the hit lanes' entries
+			__m256 entries = _mm256_blendv_ps(_mm256_set1_ps(FLT_MAX), tNear, hit);
+			entries = _mm256_min_ps(entries, _mm256_permute2f128_ps(entries, entries, 1));
+			entries = _mm256_min_ps(entries, _mm256_shuffle_ps(entries, entries, _MM_SHUFFLE(1, 0, 3, 2)));
+			entries = _mm256_min_ps(entries, _mm256_shuffle_ps(entries, entries, _MM_SHUFFLE(2, 3, 0, 1)));
+			nearestEntry = _mm256_cvtss_f32(entries);
+		}
+		return mask;
+	}
+#endif
+
+	// the largest closest-hit distance over the active lanes, nodes entered past it are skipped
+	float FarthestHit() const noexcept
+	{
+		float farthest = -FLT_MAX;
+		for (uint32_t lane = 0; lane < SIZE; ++lane)
+		{
+			farthest = fmaxf(farthest, tMax[lane]);
+		}
+		return farthest;
+	}
+
+	Ray LaneRay(uint32_t lane) const noexcept
+	{
+		return Ray{ Vec3f(originX[lane], originY[lane], originZ[lane]), Vec3f(directionX[lane], directionY[lane], directionZ[lane]) };
+	}
+};
+
+#endif
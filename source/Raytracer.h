@@ -3,12 +3,19 @@
 
 #include <memory>
 #include <algorithm>
-#include <execution>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <string>
 #include "Renderer.h"
-#include "Sphere.h"
+#include "Scene.h"
 #include "Camera.h"
 #include "Random.h"
 #include "Material.h"
+#include "ThreadPool.h"
+#include "Heatmap.h"
+#include "Wavefront.h"
 
 //#define SINGLE_THREADED
 
@@ -19,10 +26,43 @@ public:
 	RaytracingInAWeekend()
 	{
 		ClearScreenEveryFrame(false);
+#ifdef SINGLE_THREADED
+		SetThreadCount(1);
+#else
+		SetThreadCount(0);
+#endif
 		BuildWorld();
+		BuildAccelerationStructure();
+	}
+
+	void BuildAccelerationStructure()
+	{
+		m_scene.Build();
+	}
+
+	// replaces the scene built by the constructor, call before Start()
+	void LoadScene(uint32_t seed, uint32_t gridScale, uint32_t lights = 0)
+	{
+		m_scene.Clear();
+		BuildWorld(seed, gridScale, lights);
+		BuildAccelerationStructure();
 	}
 
-	void BuildWorld() noexcept
+	// the canvas size is only known once Start() ran
+	void OnStart() noexcept override
+	{
+		BuildCamera();
+		if constexpr (STATS::ENABLED)
+		{
+			m_counterBaseline = m_counterTotals = STATS::Collect();
+		}
+		if (!m_outputPath.empty())
+		{
+			m_outputOk = m_output.Open(m_outputPath.c_str(), ImageFormatFromPath(m_outputPath), static_cast<uint32_t>(canvasWidth), static_cast<uint32_t>(canvasHeight));
+		}
+	}
+
+	void BuildCamera() noexcept
 	{
 		aspectRatio = float(canvasWidth) / float(canvasHeight);
 
@@ -33,14 +73,269 @@ public:
 		float fieldOfView = 70.0f;
 
 		worldCam = Camera(lookFrom, lookAt, Vec3f(0, 1.0f, 0), aspectRatio, fieldOfView, aperture, distToFocus);
+	}
+
+	// Offline rendering: quits once the image converged, maxSamples samples per pixel
+	// were taken or maxSeconds passed since the first frame. 0 disables a limit
+	void SetRenderBudget(uint32_t maxSamples, float maxSeconds) noexcept
+	{
+		m_offline = true;
+		m_budgetSamples = maxSamples;
+		m_budgetSeconds = maxSeconds;
+	}
+
+	// Testing aid: the process ends without any cleanup after rendering tiles tiles, as if
+	// it was killed, so checkpoint recovery can be tested at a known point
+	void SetExitAfterTiles(size_t tiles) noexcept { m_exitAfterTiles = tiles; }
+
+	// Offline rendering: converged tiles are written to path (PPM, PNG or PFM by
+	// extension) as soon as they stop receiving samples, the rest once the budget ran out
+	void SetStreamingOutput(std::string path)
+	{
+		m_outputPath = std::move(path);
+	}
+
+	// writes the tiles not streamed yet, safe to call again once everything was written
+	bool FinishStreamingOutput()
+	{
+		if (!m_output.IsOpen())
+		{
+			return m_outputOk;
+		}
+		RT_PROFILE_SCOPE("Finish output");
+
+		const size_t tilesX = (canvasWidth + m_tileSize - 1) / m_tileSize;
+		m_tileWritten.resize(m_activeTiles.size(), 0);
+		for (size_t tile = 0; tile < m_tileWritten.size(); ++tile)
+		{
+			if (!m_tileWritten[tile])
+			{
+				WriteTile(tile, tilesX);
+			}
+		}
+		m_outputOk = m_output.Close() && m_outputOk;
+		return m_outputOk;
+	}
+
+	// scene plus every setting that changes the value of a given sample
+	uint64_t SampleIdentity() const noexcept
+	{
+		uint64_t hash = m_scene.Hash();
+		hash = HashValue(m_samplerType, hash);
+		hash = HashValue(m_maxDepth, hash);
+		hash = HashValue(m_rouletteStartDepth, hash);
+		// light sampling only changes the samples of scenes with lights, the identity
+		// of unlit scenes stays what it was
+		if (m_scene.LightCount() > 0)
+		{
+			hash = HashValue(m_lightSampling, hash);
+		}
+		return hash;
+	}
+
+	// samples plus the settings that decide where they go
+	uint64_t CheckpointIdentity() const noexcept override
+	{
+		uint64_t hash = SampleIdentity();
+		hash = HashValue(m_adaptiveThreshold, hash);
+		hash = HashValue(m_adaptiveMinSamples, hash);
+		return HashValue(m_tileSize, hash);
+	}
+
+	// Sampling is counter based, a pixel's next sample only depends on its sample count
+	// which lives in the checkpointed buffers, so the sampler type is the whole RNG state
+	void SaveCheckpoint(CheckpointHeader& header) const noexcept override
+	{
+		header.sampleIndex = m_sampleIndex;
+		header.rngState = static_cast<uint64_t>(m_samplerType);
+	}
+
+	// the tile mask is a function of the restored buffers, so it is rebuilt rather than stored
+	void LoadCheckpoint(const CheckpointHeader& header) noexcept override
+	{
+		m_sampleIndex = static_cast<size_t>(header.sampleIndex);
+
+		const size_t tilesX = (canvasWidth + m_tileSize - 1) / m_tileSize;
+		const size_t tilesY = (canvasHeight + m_tileSize - 1) / m_tileSize;
+		m_activeTiles.assign(tilesX * tilesY, 1);
+		m_tileWritten.assign(tilesX * tilesY, 0);
+		for (size_t tile = 0; tile < m_activeTiles.size(); ++tile)
+		{
+			const size_t x0 = (tile % tilesX) * m_tileSize;
+			const size_t y0 = (tile / tilesX) * m_tileSize;
+			m_activeTiles[tile] = TileNeedsSamples(x0, y0, std::min(x0 + m_tileSize, canvasWidth), std::min(y0 + m_tileSize, canvasHeight));
+		}
+	}
+
+	uint64_t RaysTraced() const noexcept { return m_raysTraced; }
+	uint64_t PathsTraced() const noexcept { return m_pathsTraced; }
+	size_t SamplesTaken() const noexcept { return m_sampleIndex - 1; }
+	size_t SphereCount() const noexcept { return m_sphereCount; }
+
+	struct FrameStats
+	{
+		float seconds; // from dispatching the frame's tiles to the last one finishing
+		uint64_t rays;
+		uint64_t paths;
+		STATS::Snapshot counters; // zero unless built with RT_STATS
+	};
+
+	// rays one sample traced: the segments of its path, one per vertex, and the shadow
+	// rays of light sampling
+	struct SampleRays
+	{
+		uint32_t path = 0;
+		uint32_t shadow = 0;
+
+		uint32_t Total() const noexcept { return path + shadow; }
+	};
+
+	// one entry per frame, only recorded for offline renders (see SetRenderBudget())
+	const std::vector<FrameStats>& FrameHistory() const noexcept { return m_frameHistory; }
+
+	// hot path counters of the last frame and of every frame since OnStart(), see Stats.h
+	const STATS::Snapshot& LastFrameCounters() const noexcept { return m_frameCounters; }
+	STATS::Snapshot TotalCounters() const { return STATS::ENABLED ? STATS::Collect() - m_counterBaseline : STATS::Snapshot(); }
+
+	// scattering stops after maxDepth bounces
+	void SetMaxDepth(int maxDepth) noexcept
+	{
+		m_maxDepth = maxDepth;
+	}
+
+	// Russian roulette is only played from this bounce on
+	void SetRouletteStartDepth(int depth) noexcept
+	{
+		m_rouletteStartDepth = depth;
+	}
+
+	// Both integrators compute the same samples, only the order of the work differs.
+	// Wavefront batches are one tile each, so the tile size is the batch size
+	void SetIntegrator(Integrator integrator) noexcept
+	{
+		m_integrator = integrator;
+	}
 
-		World.emplace_back(std::make_unique<Sphere>(1000.0f, Vec3f(0, -1000.0f, -2.0f)));  // lambertian
-		World[0].get()->material.SetLambertian(Vec3f(0.35f, 0.15f, 0.35f));
+	// Camera rays of 4x2 pixel blocks are traced as one packet each, the image is
+	// the same either way. Needs AVX2 and a BVH, otherwise every ray goes alone.
+	// Off by default: packets beat single rays through the binary BVH but not through
+	// the wide ones, whose nodes already fill the vector lanes
+	void SetPacketTracing(bool enabled) noexcept
+	{
+		m_packetTracing = enabled;
+	}
+
+	bool PacketTracing() const noexcept { return m_packetTracing && m_scene.PacketsSupported(); }
+
+	// Next event estimation: Lambertian vertices sample an emissive sphere and cast a
+	// shadow ray, combined with BSDF sampling by multiple importance sampling. Off
+	// leaves lights to BSDF sampling alone, same expected image with more noise
+	void SetLightSampling(bool enabled) noexcept
+	{
+		m_lightSampling = enabled;
+	}
+
+	// Sorts the wavefront's secondary rays by origin and direction before each
+	// bounce's intersect stage, see Wavefront::Reorder. The megakernel has no queue
+	// to sort and ignores it
+	void SetRayReordering(bool enabled) noexcept
+	{
+		m_rayReordering = enabled;
+	}
+
+	// switching samplers restarts accumulation so sample counts stay comparable
+	void SetSampler(SamplerType type) noexcept
+	{
+		m_samplerType = type;
+		RestartAccumulation();
+	}
+
+	// Tiles stop receiving samples once every pixel has minSamples and a relative
+	// standard error under threshold. A threshold <= 0 samples every pixel every frame
+	void SetAdaptiveSampling(float threshold, uint32_t minSamples = 32) noexcept
+	{
+		m_adaptiveThreshold = threshold;
+		m_adaptiveMinSamples = minSamples;
+		RestartAccumulation();
+	}
+
+	// Renders a heatmap of the chosen cost instead of the image, see Heatmap.h. scale
+	// is the per sample cost shown as white, 0 follows the most expensive pixel. While
+	// a view is set the megakernel traces single rays, whatever the integrator and packet
+	// settings. Fails for views whose counters are compiled out
+	bool SetDebugView(DebugView view, float scale = 0.0f) noexcept
+	{
+		if (!DebugViewAvailable(view))
+		{
+			return false;
+		}
+		m_debugView = view;
+		m_heatScale = scale;
+		RestartAccumulation();
+		return true;
+	}
+
+	DebugView GetDebugView() const noexcept { return m_debugView; }
+	// the per sample cost drawn as white in the last resolved heatmap
+	float HeatmapScale() const noexcept { return m_heatScale > 0.0f ? m_heatScale : m_heatMax; }
+
+	void RestartAccumulation() noexcept
+	{
+		m_sampleIndex = 1;
+		std::fill(m_heatSums.begin(), m_heatSums.end(), 0.0f);
+		std::fill(m_heatCounts.begin(), m_heatCounts.end(), 0u);
+		ResetAccumulation();
+		std::fill(m_activeTiles.begin(), m_activeTiles.end(), static_cast<uint8_t>(1));
+		SetConverged(false);
+	}
+
+	// 0 uses every hardware thread
+	void SetThreadCount(size_t threadCount)
+	{
+		m_pool = std::make_unique<ThreadPool>(threadCount);
+	}
+
+	// Tiles are the unit of scheduling and of adaptive sampling. Changing the size
+	// keeps the accumulated samples, every tile is simply marked active again
+	void SetTileSize(size_t tileSize) noexcept
+	{
+		m_tileSize = std::max<size_t>(tileSize, 1);
+		m_activeTiles.clear();
+		SetConverged(false);
+	}
+
+	const ThreadPool& GetThreadPool() const noexcept { return *m_pool; }
+
+	// LINEAR falls back to testing every primitive for every ray
+	void SetAccelerationStructure(AccelerationStructure value) noexcept
+	{
+		m_scene.SetAccelerationStructure(value);
+	}
+
+	SamplerType GetSampler() const noexcept { return m_samplerType; }
+	Integrator GetIntegrator() const noexcept { return m_integrator; }
+	int GetMaxDepth() const noexcept { return m_maxDepth; }
+	int GetRouletteStartDepth() const noexcept { return m_rouletteStartDepth; }
+	AccelerationStructure GetAccelerationStructure() const noexcept { return m_scene.GetAccelerationStructure(); }
+	// the structure actually built, BVH8 falls back to BVH4 without AVX2
+	const char* AccelerationStructureName() const noexcept { return m_scene.AccelerationStructureName(); }
+
+	// Seed 0 is the default layout. gridScale grows the field of small spheres to
+	// gridScale^2 times as many candidates, for benchmarking larger scenes. lights
+	// adds small emissive spheres above the field and turns the sky down to a night
+	// sky, so the scene is lit by them
+	void BuildWorld(uint32_t seed = 0, uint32_t gridScale = 1, uint32_t lights = 0) noexcept
+	{
+		RANDOM::SeedScene(seed);
+
+		Material material;
+		material.SetLambertian(Vec3f(0.35f, 0.15f, 0.35f));
+		m_scene.AddSphere(1000.0f, Vec3f(0, -1000.0f, -2.0f), m_scene.AddMaterial(material));  // lambertian
 		
 		size_t sphereCount = 1;
-		for (size_t i = 1; i < 7; i++)
+		for (size_t i = 1; i < 1 + 6 * gridScale; i++)
 		{
-			for (size_t j = 0; j < 8; j++)
+			for (size_t j = 0; j < 8 * gridScale; j++)
 			{
 				float chooseMat = RANDOM::RandomInterval();
 				Vec3f center(i + 0.9f * RANDOM::RandomInterval(-float(j+i), float(j)), 0.2f, j + 0.9f * RANDOM::RandomInterval(-float(i+j), float(j)));
@@ -49,28 +344,40 @@ public:
 				{
 					if (chooseMat < 0.2f) // metallic
 					{
-						World.emplace_back(std::make_unique<Sphere>(0.2f, center));
-						World[sphereCount++].get()->material.SetMetallic(Vec3f(0.5f * (RANDOM::RandomInterval() + RANDOM::RandomInterval()), 0.5f * (RANDOM::RandomInterval() + RANDOM::RandomInterval()), 0.5f * (RANDOM::RandomInterval() + RANDOM::RandomInterval())), RANDOM::RandomInterval());
+						material.SetMetallic(Vec3f(0.5f * (RANDOM::RandomInterval() + RANDOM::RandomInterval()), 0.5f * (RANDOM::RandomInterval() + RANDOM::RandomInterval()), 0.5f * (RANDOM::RandomInterval() + RANDOM::RandomInterval())), RANDOM::RandomInterval());
 					}
 					else if (chooseMat < 0.7f) // diffuse
 					{
-						World.emplace_back(std::make_unique<Sphere>(0.2f, center));
-						World[sphereCount++].get()->material.SetLambertian(Vec3f(RANDOM::RandomInterval()* RANDOM::RandomInterval(), RANDOM::RandomInterval()* RANDOM::RandomInterval(), RANDOM::RandomInterval()* RANDOM::RandomInterval()));
+						material.SetLambertian(Vec3f(RANDOM::RandomInterval()* RANDOM::RandomInterval(), RANDOM::RandomInterval()* RANDOM::RandomInterval(), RANDOM::RandomInterval()* RANDOM::RandomInterval()));
 					}
 					else // dieletric
 					{
-						World.emplace_back(std::make_unique<Sphere>(0.2f, center));
-						World[sphereCount++].get()->material.SetDieletric(1 + RANDOM::RandomInterval(0.0f, 1.0f));
+						material.SetDieletric(1 + RANDOM::RandomInterval(0.0f, 1.0f));
 					}
+					m_scene.AddSphere(0.2f, center, m_scene.AddMaterial(material));
+					++sphereCount;
 				}
 			}
 		}
-		World.emplace_back(std::make_unique<Sphere>(1.0f, Vec3f(0, 1.0f, 0)));
-		World[sphereCount++].get()->material.SetDieletric(1.5f);
-		World.emplace_back(std::make_unique<Sphere>(1.0f, Vec3f(-4.0f, 1.0f, 0)));
-		World[sphereCount++].get()->material.SetLambertian(Vec3f(0.4f,0.2f,0.1f));
-		World.emplace_back(std::make_unique<Sphere>(1.0f, Vec3f(4.0f, 1.0f, 0)));
-		World[sphereCount++].get()->material.SetMetallic(Vec3f(0.7f, 0.6f, 0.5f), 0.15f);
+		material.SetDieletric(1.5f);
+		m_scene.AddSphere(1.0f, Vec3f(0, 1.0f, 0), m_scene.AddMaterial(material));
+		material.SetLambertian(Vec3f(0.4f,0.2f,0.1f));
+		m_scene.AddSphere(1.0f, Vec3f(-4.0f, 1.0f, 0), m_scene.AddMaterial(material));
+		material.SetMetallic(Vec3f(0.7f, 0.6f, 0.5f), 0.15f);
+		m_scene.AddSphere(1.0f, Vec3f(4.0f, 1.0f, 0), m_scene.AddMaterial(material));
+		sphereCount += 3;
+
+		for (uint32_t i = 0; i < lights; ++i)
+		{
+			material.SetEmissive(Vec3f(1.0f, RANDOM::RandomInterval(0.6f, 0.9f), RANDOM::RandomInterval(0.3f, 0.6f)) * 40.0f);
+			const Vec3f center(RANDOM::RandomInterval(-4.0f, 5.0f), RANDOM::RandomInterval(1.4f, 2.6f), RANDOM::RandomInterval(-5.0f, 1.0f));
+			m_scene.AddSphere(0.12f, center, m_scene.AddMaterial(material));
+			++sphereCount;
+		}
+		if (lights > 0)
+		{
+			m_scene.SetSkyIntensity(0.02f);
+		}
 
 		m_sphereCount = sphereCount;
 	}
@@ -81,92 +388,544 @@ public:
 		static std::string titleBar;
 		dtAcc += dt;
 
-		static size_t currentSampleIndex = 1;
+		if (m_offline && TimeBudgetExhausted())
+		{
+			ResolveHeatmap();
+			FinishStreamingOutput();
+			SetConverged(true);
+			Quit();
+			return;
+		}
+
+		const size_t tilesX = (canvasWidth + m_tileSize - 1) / m_tileSize;
+		const size_t tilesY = (canvasHeight + m_tileSize - 1) / m_tileSize;
+		if (m_activeTiles.size() != tilesX * tilesY)
+		{
+			m_activeTiles.assign(tilesX * tilesY, 1);
+			m_tileWritten.assign(tilesX * tilesY, 0);
+		}
+		if (m_debugView != DebugView::NONE && m_heatCounts.size() != canvasWidth * canvasHeight)
+		{
+			m_heatSums.assign(canvasWidth * canvasHeight, 0.0f);
+			m_heatCounts.assign(canvasWidth * canvasHeight, 0u);
+		}
 
-		if (dtAcc > 1.f)
 		{
-			titleBar = "Samples: " + std::to_string(currentSampleIndex) + ", FPS: " + std::to_string(currentFPS) + ", Spheres: " + std::to_string(m_sphereCount);
+			RT_PROFILE_SCOPE("Schedule tiles");
+			m_tileQueue.clear();
+			for (size_t tile = 0; tile < m_activeTiles.size(); ++tile)
+			{
+				if (m_activeTiles[tile])
+				{
+					m_tileQueue.push_back(tile);
+				}
+			}
+		}
+
+		if (dtAcc > 1.f || m_tileQueue.empty())
+		{
+			titleBar = "Samples: " + std::to_string(m_sampleIndex) + ", FPS: " + std::to_string(currentFPS) + ", Spheres: " + std::to_string(m_sphereCount) + ", " + m_scene.AccelerationStructureName() + ", " + SamplerName(m_samplerType) + ", " + IntegratorName(m_integrator) + (PacketTracing() ? ", packets" : "") +
+				(m_integrator == Integrator::WAVEFRONT && m_rayReordering ? ", reordered" : "");
+			titleBar += m_tileQueue.empty() ? ", Converged" : ", Active tiles: " + std::to_string(m_tileQueue.size()) + "/" + std::to_string(m_activeTiles.size());
+			titleBar += ", Threads: " + std::to_string(m_pool->ThreadCount()) + " @ " + std::to_string(static_cast<int>(100.0 * m_pool->AverageUtilization())) + "%";
+			if constexpr (STATS::ENABLED)
+			{
+				titleBar += ", " + m_frameCounters.Summary();
+			}
+			if (m_debugView != DebugView::NONE)
+			{
+				titleBar += ", Heatmap: " + std::string(DebugViewName(m_debugView)) + " 0-" + std::to_string(static_cast<int>(HeatmapScale() + 0.5f));
+			}
 			SetWindowTitle(titleBar.c_str());
+			m_pool->ResetStats();
 			dtAcc = 0;
 		}
 
-#ifdef SINGLE_THREADED
-		for (size_t y = 0; y < canvasHeight; y++)
+		// every tile is under the error threshold, nothing left to do until something resets
+		if (m_tileQueue.empty())
 		{
-			for (size_t x = 0; x < canvasWidth; x++)
+			SetConverged(true);
+			if (m_offline)
+			{
+				FinishStreamingOutput();
+				Quit();
+			}
+			return;
+		}
+
+		const auto frameStart = std::chrono::steady_clock::now();
+		const uint64_t raysBefore = m_raysTraced;
+		const uint64_t pathsBefore = m_pathsTraced;
+
+		m_pool->ParallelFor(m_tileQueue.size(), [&](size_t job) noexcept -> void
 			{
-				const float u = float(x) / float(canvasWidth - 1);
-				const float v = float(canvasHeight - 1 - y) / float(canvasHeight - 1); // Invert Y axis
+				const size_t tile = m_tileQueue[job];
+				const size_t x0 = (tile % tilesX) * m_tileSize;
+				const size_t y0 = (tile / tilesX) * m_tileSize;
+				const size_t x1 = std::min(x0 + m_tileSize, canvasWidth);
+				const size_t y1 = std::min(y0 + m_tileSize, canvasHeight);
 
-				DrawPixel((uint16_t)x, (uint16_t)y, RayColor(worldCam.GetRay(u, v), 0), currentSampleIndex);
+				uint64_t rays = 0;
+				if (m_integrator == Integrator::WAVEFRONT && m_debugView == DebugView::NONE)
+				{
+					rays = RenderTileWavefront(x0, y0, x1, y1);
+				}
+				else if (PacketTracing() && m_debugView == DebugView::NONE)
+				{
+					rays = RenderTilePackets(x0, y0, x1, y1);
+				}
+				else
+				{
+					for (size_t y = y0; y < y1; ++y)
+					{
+						for (size_t x = x0; x < x1; ++x)
+						{
+							rays += RenderPixel(x, y);
+						}
+					}
+				}
+				m_raysTraced += rays;
+				m_pathsTraced += (x1 - x0) * (y1 - y0);
+				m_activeTiles[tile] = TileNeedsSamples(x0, y0, x1, y1);
+
+				if (!m_activeTiles[tile] && m_output.IsOpen())
+				{
+					RT_PROFILE_SCOPE("Write tile");
+					std::lock_guard<std::mutex> lock(m_outputMutex);
+					WriteTile(tile, tilesX);
+				}
+				if (m_exitAfterTiles > 0 && ++m_tilesRendered >= m_exitAfterTiles)
+				{
+					std::_Exit(EXIT_FAILURE);
+				}
+			}, "Tile");
+		++m_sampleIndex;
+		const float frameSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - frameStart).count();
+		ResolveHeatmap();
+
+		// the pool joined, no worker is counting
+		if constexpr (STATS::ENABLED)
+		{
+			const STATS::Snapshot totals = STATS::Collect();
+			m_frameCounters = totals - m_counterTotals;
+			m_counterTotals = totals;
+		}
+
+		if (m_offline)
+		{
+			m_frameHistory.push_back({ frameSeconds, m_raysTraced - raysBefore, m_pathsTraced - pathsBefore, m_frameCounters });
+		}
+	}
+
+	// returns the number of rays traced for the sample
+	uint32_t RenderPixel(size_t x, size_t y) noexcept
+	{
+		if (m_debugView != DebugView::NONE)
+		{
+			return RenderHeatPixel(x, y);
+		}
+
+		// pixels advance through their own sample sequence, adaptive sampling makes counts diverge
+		const uint32_t sampleIndex = PixelSampleCount(x, y);
+
+		SampleRays rays;
+		DrawPixel(static_cast<uint16_t>(x), static_cast<uint16_t>(y), TraceSample(x, y, sampleIndex, rays), sampleIndex + 1);
+		return rays.Total();
+	}
+
+	// The tile's next sample of every pixel as one wavefront batch, each pool thread
+	// keeps its queues from tile to tile
+	uint64_t RenderTileWavefront(size_t x0, size_t y0, size_t x1, size_t y1) noexcept
+	{
+		static thread_local Wavefront wavefront;
+		wavefront.Begin((x1 - x0) * (y1 - y0));
+		for (size_t y = y0; y < y1; ++y)
+		{
+			for (size_t x = x0; x < x1; ++x)
+			{
+				Sampler sampler(m_samplerType, static_cast<uint32_t>(x), static_cast<uint32_t>(y), static_cast<uint32_t>(canvasWidth), PixelSampleCount(x, y));
+				wavefront.AddPath(CameraRay(x, y, sampler), sampler);
 			}
 		}
-#else
-		static std::vector<size_t> indices(canvasHeight * canvasWidth);
-		std::iota(indices.begin(), indices.end(), 0);
 
-		std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t idx) noexcept -> void
+		Wavefront::Settings settings;
+		settings.maxDepth = m_maxDepth;
+		settings.rouletteStartDepth = m_rouletteStartDepth;
+		settings.primaryPackets = PacketTracing();
+		settings.reorderSecondary = m_rayReordering;
+		settings.lightSampling = m_lightSampling;
+		const uint64_t rays = wavefront.Trace(m_scene, settings);
+
+		size_t path = 0;
+		for (size_t y = y0; y < y1; ++y)
+		{
+			for (size_t x = x0; x < x1; ++x)
 			{
-				const size_t x = idx % canvasWidth;
-				const size_t y = idx / canvasWidth;
+				DrawPixel(static_cast<uint16_t>(x), static_cast<uint16_t>(y), wavefront.Radiance(path++), PixelSampleCount(x, y) + 1);
+			}
+		}
+		return rays;
+	}
 
-				const float u = static_cast<float>(x + RANDOM::RandomInterval()) / static_cast<float>(canvasWidth - 1);
-				const float v = static_cast<float>(canvasHeight - 1 - y + RANDOM::RandomInterval()) / static_cast<float>(canvasHeight - 1); // Invert Y axis
+	// The tile's next sample with the camera rays of each 4x2 pixel block intersected
+	// as one packet, the paths then continue one ray at a time
+	uint64_t RenderTilePackets(size_t x0, size_t y0, size_t x1, size_t y1) noexcept
+	{
+#if RAY_PACKETS
+		uint64_t rays = 0;
+		for (size_t blockY = y0; blockY < y1; blockY += 2)
+		{
+			for (size_t blockX = x0; blockX < x1; blockX += 4)
+			{
+				const size_t blockX1 = std::min(blockX + 4, x1);
+				const size_t blockY1 = std::min(blockY + 2, y1);
 
-				DrawPixel(static_cast<uint16_t>(x), static_cast<uint16_t>(y), RayColor(worldCam.GetRay(u, v), 0), currentSampleIndex);
-			});
+				Ray primary[RayPacket::SIZE];
+				HitRegistry hits[RayPacket::SIZE];
+				uint32_t count = 0;
+				for (size_t y = blockY; y < blockY1; ++y)
+				{
+					for (size_t x = blockX; x < blockX1; ++x)
+					{
+						Sampler sampler(m_samplerType, static_cast<uint32_t>(x), static_cast<uint32_t>(y), static_cast<uint32_t>(canvasWidth), PixelSampleCount(x, y));
+						primary[count++] = CameraRay(x, y, sampler);
+					}
+				}
+				m_scene.ClosestHitPacket(primary, count, 0.001f, 5000.1f, hits);
+
+				// a new sampler picks up where the camera ray's left off, bounces restart its dimensions
+				uint32_t lane = 0;
+				for (size_t y = blockY; y < blockY1; ++y)
+				{
+					for (size_t x = blockX; x < blockX1; ++x, ++lane)
+					{
+						const uint32_t sampleIndex = PixelSampleCount(x, y);
+						Sampler sampler(m_samplerType, static_cast<uint32_t>(x), static_cast<uint32_t>(y), static_cast<uint32_t>(canvasWidth), sampleIndex);
+						SampleRays sampleRays;
+						DrawPixel(static_cast<uint16_t>(x), static_cast<uint16_t>(y), RayColor(primary[lane], sampler, sampleRays, &hits[lane]), sampleIndex + 1);
+						rays += sampleRays.Total();
+					}
+				}
+			}
+		}
+		return rays;
+#else
+		uint64_t rays = 0;
+		for (size_t y = y0; y < y1; ++y)
+		{
+			for (size_t x = x0; x < x1; ++x)
+			{
+				rays += RenderPixel(x, y);
+			}
+		}
+		return rays;
 #endif
-		++currentSampleIndex;
 	}
 
-	Vec3f RayColor(const Ray& r, int depth)
+	// Traces the pixel's next production sample and adds its cost to the heat sums,
+	// the counters are per thread so the delta around TraceSample is this sample's
+	uint32_t RenderHeatPixel(size_t x, size_t y) noexcept
+	{
+		const size_t pixel = y * canvasWidth + x;
+		const uint64_t* counters = STATS::Local().counters;
+		const STATS::Counter counter = m_debugView == DebugView::BVH_NODES ? STATS::BVH_NODES : STATS::PRIMITIVE_TESTS;
+		const uint64_t before = counters[counter];
+
+		SampleRays rays;
+		TraceSample(x, y, m_heatCounts[pixel], rays);
+		m_heatSums[pixel] += m_debugView == DebugView::PATH_LENGTH ? static_cast<float>(rays.path) : static_cast<float>(counters[counter] - before);
+		++m_heatCounts[pixel];
+		return rays.Total();
+	}
+
+	// Redraws every pixel from the mean heat, run after the pool joined. The
+	// accumulation holds the false colors, so the presenter and the image writers
+	// show the heatmap without knowing about it
+	void ResolveHeatmap() noexcept
 	{
-		HitRegistry rec;
+		if (m_debugView == DebugView::NONE || m_heatCounts.empty())
+		{
+			return;
+		}
 
-		if (ClosestHit(r, 0.001f, 5000.1f, &rec))
+		RT_PROFILE_SCOPE("Resolve heatmap");
+		float maxHeat = 0.0f;
+		for (size_t pixel = 0; pixel < m_heatCounts.size(); ++pixel)
 		{
-			Ray scattered;
-			Vec3f attenuation;
-			
-			if (depth < 50 && rec.material.Scatter(r, &rec, attenuation, scattered))
+			if (m_heatCounts[pixel])
 			{
-				return attenuation * RayColor(scattered, depth + 1);
+				maxHeat = fmaxf(maxHeat, m_heatSums[pixel] / static_cast<float>(m_heatCounts[pixel]));
 			}
-			else
+		}
+		m_heatMax = maxHeat;
+
+		const float inverseScale = 1.0f / fmaxf(HeatmapScale(), 1.0f);
+		m_pool->ParallelFor(canvasHeight, [&](size_t y) noexcept -> void
 			{
-				return Vec3f(0, 0, 0);
-			}
+				for (size_t x = 0; x < canvasWidth; ++x)
+				{
+					const size_t pixel = y * canvasWidth + x;
+					const float heat = m_heatCounts[pixel] ? m_heatSums[pixel] / static_cast<float>(m_heatCounts[pixel]) : 0.0f;
+					DrawPixel(static_cast<uint16_t>(x), static_cast<uint16_t>(y), HeatColor(heat * inverseScale), 1);
+				}
+			}, "Heatmap row");
+	}
+
+	// Sample sampleIndex of pixel (x, y), a pure function of its arguments, which is
+	// what lets separate processes render disjoint sample ranges of the same pixel
+	Vec3f TraceSample(size_t x, size_t y, uint32_t sampleIndex, SampleRays& rays) noexcept
+	{
+		Sampler sampler(m_samplerType, static_cast<uint32_t>(x), static_cast<uint32_t>(y), static_cast<uint32_t>(canvasWidth), sampleIndex);
+		return RayColor(CameraRay(x, y, sampler), sampler, rays);
+	}
+
+	// jittered primary ray through pixel (x, y), consumes the camera vertex of the sampler
+	Ray CameraRay(size_t x, size_t y, Sampler& sampler) const noexcept
+	{
+		const float u = static_cast<float>(x + sampler.Next()) / static_cast<float>(canvasWidth - 1);
+		const float v = static_cast<float>(canvasHeight - 1 - y + sampler.Next()) / static_cast<float>(canvasHeight - 1); // Invert Y axis
+		return worldCam.GetRay(u, v, sampler);
+	}
+
+	// Renders samples [sampleBegin, sampleBegin + sampleCount) of a region into caller
+	// owned buffers laid out like the accumulation (RGB sums, squared luminance sums,
+	// sample counts, regionWidth pixels per row), rows are spread over the thread pool.
+	// Used by distributed workers, which have no window and no accumulation of their own
+	uint64_t RenderRegion(size_t x0, size_t y0, size_t regionWidth, size_t regionHeight, uint32_t sampleBegin, uint32_t sampleCount, float* sums, float* luminanceSquared, uint32_t* counts) noexcept
+	{
+		std::atomic<uint64_t> totalRays = 0;
+		m_pool->ParallelFor(regionHeight, [&](size_t row) noexcept -> void
+			{
+				uint64_t rays = 0;
+				for (size_t column = 0; column < regionWidth; ++column)
+				{
+					const size_t pixel = row * regionWidth + column;
+					Vec3f sum(0.0f, 0.0f, 0.0f);
+					float luminanceSum = 0.0f;
+					for (uint32_t sample = sampleBegin; sample < sampleBegin + sampleCount; ++sample)
+					{
+						SampleRays sampleRays;
+						const Vec3f color = TraceSample(x0 + column, y0 + row, sample, sampleRays);
+						const float luminance = Luminance(color);
+						sum += color;
+						luminanceSum += luminance * luminance;
+						rays += sampleRays.Total();
+					}
+					sums[pixel * 3    ] = sum.r;
+					sums[pixel * 3 + 1] = sum.g;
+					sums[pixel * 3 + 2] = sum.b;
+					luminanceSquared[pixel] = luminanceSum;
+					counts[pixel] = sampleCount;
+				}
+				totalRays += rays;
+			}, "Region row");
+		m_raysTraced += totalRays;
+		m_pathsTraced += static_cast<uint64_t>(regionWidth) * regionHeight * sampleCount;
+		return totalRays;
+	}
+
+	// Workers render without Start(), so they set the canvas and camera up directly
+	void SetCanvasSize(size_t width, size_t height) noexcept
+	{
+		canvasWidth = width;
+		canvasHeight = height;
+		BuildCamera();
+	}
+
+	// caller holds m_outputMutex or is the only thread touching the output
+	void WriteTile(size_t tile, size_t tilesX)
+	{
+		const size_t x0 = (tile % tilesX) * m_tileSize;
+		const size_t y0 = (tile / tilesX) * m_tileSize;
+		const size_t x1 = std::min(x0 + m_tileSize, canvasWidth);
+		const size_t y1 = std::min(y0 + m_tileSize, canvasHeight);
+		const size_t pixel = y0 * canvasWidth + x0;
+
+		m_outputOk = m_output.WriteTile(static_cast<uint32_t>(x0), static_cast<uint32_t>(y0), static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0),
+			AccumulationData() + pixel * 3, canvasWidth * 3, SampleCountData() + pixel, canvasWidth) && m_outputOk;
+		m_tileWritten[tile] = 1;
+	}
+
+	// the sample budget ends the render through TileNeedsSamples, once no tile is left
+	bool TimeBudgetExhausted() noexcept
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (!m_renderStarted)
+		{
+			m_renderStart = now;
+			m_renderStarted = true;
 		}
-		else
+		const float seconds = std::chrono::duration<float>(now - m_renderStart).count();
+		return m_budgetSeconds > 0.0f && seconds >= m_budgetSeconds;
+	}
+
+	uint32_t PixelSamplesTaken(size_t x, size_t y) const noexcept
+	{
+		if (m_debugView != DebugView::NONE)
 		{
-			const Vec3f unit_direction = unit_vector(r.direction);
-			const float t = 0.5f * (unit_direction.y + 1.0f);
-			return (1.0f-t) * Vec3f(1.0f, 1.0f, 1.0f) + t*Vec3f(0.5f, 0.7f, 1.0f);
+			return m_heatCounts.empty() ? 0 : m_heatCounts[y * canvasWidth + x];
 		}
+		return PixelSampleCount(x, y);
 	}
 
-	bool ClosestHit(const Ray& r, float t_min, float t_max, HitRegistry* rec) noexcept
+	// The sample budget is per pixel: a render killed mid-frame leaves some tiles a sample
+	// ahead, resuming must not give the others one on top of the budget
+	bool TileNeedsSamples(size_t x0, size_t y0, size_t x1, size_t y1) const noexcept
 	{
-		bool hit_anything = false;
-		HitRegistry temp_rec;
+		// the accumulation holds false colors, its error says nothing
+		const bool adaptive = m_adaptiveThreshold > 0.0f && m_debugView == DebugView::NONE;
+		for (size_t y = y0; y < y1; ++y)
+		{
+			for (size_t x = x0; x < x1; ++x)
+			{
+				const uint32_t samples = PixelSamplesTaken(x, y);
+				if (m_budgetSamples > 0 && samples >= m_budgetSamples)
+				{
+					continue;
+				}
+				if (!adaptive || samples < m_adaptiveMinSamples || PixelRelativeError(x, y) > m_adaptiveThreshold)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
 
-		for (const auto& object : World)
+	// Iterative path integrator, the running throughput replaces the attenuation
+	// product of the old recursion. From the roulette start depth on, paths play
+	// Russian roulette (see SurviveRoulette). With lights in the scene, Lambertian
+	// vertices add light sampling (see DirectLight) and emitters found by the BSDF
+	// ray after one are weighted against it. primaryHit, when given, is the already
+	// traced closest hit of the primary ray, a negative t for a miss
+	Vec3f RayColor(const Ray& primary, Sampler& sampler, SampleRays& rays, const HitRegistry* primaryHit = nullptr) noexcept
+	{
+		Ray r = primary;
+		Vec3f throughput(1.0f, 1.0f, 1.0f);
+		Vec3f radiance(0.0f, 0.0f, 0.0f);
+		const bool sampleLights = m_lightSampling && m_scene.LightCount() > 0;
+
+		// where the last BSDF ray left and its density, 0 unless that vertex sampled lights
+		Vec3f lastPosition;
+		float lastPdf = 0.0f;
+
+		for (int depth = 0; ; ++depth)
 		{
-			if (object->HIT(r, &temp_rec, t_min, t_max))
+			sampler.StartBounce(static_cast<uint32_t>(depth + 1));
+
+			HitRegistry rec;
+			++rays.path;
+			RT_STAT_ADD(depth == 0 ? STATS::PRIMARY_RAYS : STATS::SECONDARY_RAYS, 1);
+			const bool hit = depth == 0 && primaryHit ? (rec = *primaryHit).t >= 0.0f : ClosestHit(r, 0.001f, 5000.1f, &rec);
+			if (!hit)
 			{
-				hit_anything = true;
-				t_max = temp_rec.t;
-				*rec = temp_rec;
+				RT_STAT_ADD(STATS::ESCAPED, 1);
+				RT_STAT_PATH(depth);
+				return radiance + throughput * m_scene.Background(r.direction);
 			}
+
+			const Material& material = m_scene.GetMaterial(rec.materialID);
+			if (material.type == MaterialType::EMISSIVE)
+			{
+				RT_STAT_ADD(STATS::EMITTER_HITS, 1);
+				RT_STAT_PATH(depth);
+				return radiance + throughput * material.Emission * m_scene.EmissionWeight(lastPosition, lastPdf, rec);
+			}
+
+			if (depth >= m_maxDepth)
+			{
+				RT_STAT_ADD(STATS::DEPTH_LIMITED, 1);
+				RT_STAT_PATH(depth);
+				return radiance;
+			}
+
+			const bool lightVertex = sampleLights && material.type == MaterialType::LAMBERTIAN;
+			if (lightVertex)
+			{
+				Ray shadowRay;
+				float shadowDistance;
+				Vec3f contribution;
+				if (m_scene.SampleDirectLight(rec, material, sampler, shadowRay, shadowDistance, contribution))
+				{
+					++rays.shadow;
+					RT_STAT_ADD(STATS::SHADOW_RAYS, 1);
+					if (!m_scene.Occluded(shadowRay, 0.001f, shadowDistance))
+					{
+						radiance += throughput * contribution;
+					}
+				}
+			}
+
+			Ray scattered;
+			Vec3f attenuation;
+			if (!material.Scatter(r, &rec, attenuation, scattered, sampler))
+			{
+				RT_STAT_ADD(STATS::ABSORBED, 1);
+				RT_STAT_PATH(depth);
+				return radiance;
+			}
+			RT_STAT_ADD(STATS::SCATTER_LAMBERTIAN + static_cast<uint32_t>(material.type), 1);
+			throughput *= attenuation;
+			lastPosition = rec.p;
+			lastPdf = lightVertex ? Material::LambertianPdf(rec.normal, unit_vector(scattered.direction)) : 0.0f;
+
+			if (depth >= m_rouletteStartDepth && !SurviveRoulette(sampler, throughput))
+			{
+				RT_STAT_ADD(STATS::ROULETTE_KILLS, 1);
+				RT_STAT_PATH(depth + 1);
+				return radiance;
+			}
+			r = scattered;
 		}
-		return hit_anything;
+	}
+
+	bool ClosestHit(const Ray& r, float t_min, float t_max, HitRegistry* rec) const noexcept
+	{
+		return m_scene.ClosestHit(r, t_min, t_max, rec);
 	}
 
 private:
-	std::vector<std::unique_ptr<Hittable>> World = {};
+	Scene m_scene;
 	float aspectRatio = 16.0f / 9.0f;
 	Camera worldCam;
 	size_t m_sphereCount = 0;
+	int m_maxDepth = 50;
+	int m_rouletteStartDepth = 3;
+	SamplerType m_samplerType = SamplerType::SOBOL;
+	Integrator m_integrator = Integrator::MEGAKERNEL;
+	bool m_packetTracing = false;
+	bool m_rayReordering = false;
+	bool m_lightSampling = true;
+	size_t m_sampleIndex = 1;
+	float m_adaptiveThreshold = 0.01f;
+	uint32_t m_adaptiveMinSamples = 32;
+	size_t m_tileSize = 16;
+	std::vector<uint8_t> m_activeTiles;
+	std::vector<size_t> m_tileQueue;
+	std::unique_ptr<ThreadPool> m_pool;
+	DebugView m_debugView = DebugView::NONE;
+	float m_heatScale = 0.0f;
+	float m_heatMax = 0.0f;
+	std::vector<float> m_heatSums;     // per pixel cost summed over its samples
+	std::vector<uint32_t> m_heatCounts;
+	bool m_offline = false;
+	uint32_t m_budgetSamples = 0;
+	float m_budgetSeconds = 0.0f;
+	std::chrono::steady_clock::time_point m_renderStart;
+	bool m_renderStarted = false;
+	size_t m_exitAfterTiles = 0;
+	std::atomic<size_t> m_tilesRendered = 0;
+	std::atomic<uint64_t> m_raysTraced = 0;
+	std::atomic<uint64_t> m_pathsTraced = 0;
+	std::vector<FrameStats> m_frameHistory;
+	STATS::Snapshot m_counterBaseline; // totals when OnStart() ran
+	STATS::Snapshot m_counterTotals;   // totals at the end of the last frame
+	STATS::Snapshot m_frameCounters;
+	std::string m_outputPath;
+	ImageWriter m_output;
+	std::mutex m_outputMutex;
+	std::vector<uint8_t> m_tileWritten;
+	bool m_outputOk = false;
 };
 
 #endif
\ No newline at end of file
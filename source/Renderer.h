@@ -1,101 +1,180 @@
 #ifndef RT_RENDERER_H
 #define RT_RENDERER_H
 
+#include "Backend.h"
 #include "RT_Window.h"
 #include "ErrorEnum.h"
 #include "NaiveMath.h"
+#include "TripleBuffer.h"
+#include "ImageWriter.h"
+#include "MappedFile.h"
+#include "Checkpoint.h"
+#include "Profiler.h"
 #include <chrono>
-
-static constexpr size_t BACKBUFFERCOUNT = 2;
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+#include <span>
+#include <memory>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 class Application
 {
 public:
-	constexpr Application() {}
+	Application() {}
 	virtual ~Application()
 	{
-		for (size_t i = 0; i < BACKBUFFERCOUNT; ++i)
-		{
-			delete[] m_backBuffers[i];
-			if (m_bitMaps[i])
-			{
-				DeleteObject(m_bitMaps[i]);
-			}
-			if (m_bitMapsHDC[i])
-			{
-				DeleteDC(m_bitMapsHDC[i]);
-			}
-		}
-		if (m_windowContext->m_hwnd && m_windowContext->m_hdc)
-		{
-			ReleaseDC(m_windowContext->m_hwnd, m_windowContext->m_hdc);
-		}
+		StopRenderThread();
 	}
 
-	// if dt > 1.0f to check if a full second has passed
+	// Called once the canvas size is known, before the first OnUpdate
+	virtual void OnStart() noexcept {}
+
+	// Called on the render thread, dt > 1.0f to check if a full second has passed
 	virtual void OnUpdate(float dt) noexcept = 0;
 
+	// Checkpoint hooks. The identity fingerprints everything that decides whether
+	// stored samples can be continued, Save/Load carry the application's own counters.
+	// Save runs on the render thread after every frame, Load before the first one
+	virtual uint64_t CheckpointIdentity() const noexcept { return 0; }
+	virtual void SaveCheckpoint([[maybe_unused]] CheckpointHeader& header) const noexcept {}
+	virtual void LoadCheckpoint([[maybe_unused]] const CheckpointHeader& header) noexcept {}
+
+	// Opens a window where there is one and runs headless otherwise
 	RESULT_VALUE Start(uint16_t width = 800, uint16_t height = 600, std::wstring_view windowName = L"My Application") noexcept
 	{
-		m_windowContext = std::make_unique<Platform::Window>(width, height, windowName.data());
-		m_drawingRectangle.top = 0;
-		m_drawingRectangle.left = 0;
-		m_drawingRectangle.right = width;
-		m_drawingRectangle.bottom = height;
+#ifdef _WIN32
+		return Start(std::make_unique<Platform::Win32Backend>(width, height, windowName), width, height);
+#else
+		(void)windowName;
+		return Start(std::make_unique<Platform::HeadlessBackend>(), width, height);
+#endif
+	}
+
+	RESULT_VALUE Start(std::unique_ptr<Platform::Backend> backend, uint16_t width, uint16_t height) noexcept
+	{
+		m_backend = std::move(backend);
+		m_width = width;
+		m_height = height;
 
 		// For User
 		canvasWidth = width;
 		canvasHeight = height;
 
-		CreateBackBuffers();
+		const RESULT_VALUE result = CreateBackBuffers();
+		if (result != RESULT_VALUE::OK)
+		{
+			return result;
+		}
+		OnStart();
+
+		if (m_checkpointHeader)
+		{
+			if (m_resumed)
+			{
+				frameIndex = static_cast<size_t>(m_checkpointHeader->frameIndex);
+				LoadCheckpoint(*m_checkpointHeader);
+			}
+			else
+			{
+				m_checkpointHeader->frameIndex = frameIndex;
+				SaveCheckpoint(*m_checkpointHeader);
+			}
+		}
 
 		return Loop();
 	}
 
-	void DrawPixel(uint16_t x, uint16_t y, uint8_t red, uint8_t green, uint8_t blue, size_t currentSampleIndex = 1) noexcept
+	// Keeps the accumulation in a memory-mapped file instead of RAM, call before
+	// Start(). An existing file is resumed if it was written for the same resolution
+	// and CheckpointIdentity(), any other file is left alone and Start() fails.
+	// Frames land in the page cache as they are rendered, so a killed process loses
+	// nothing, the file is flushed to disk every flushIntervalSeconds
+	void SetCheckpoint(std::string path, float flushIntervalSeconds = 60.0f)
 	{
-		if (x >= m_windowContext->m_Width || y >= m_windowContext->m_Height)
-		{
-			return;
-		}
-		if (currentSampleIndex > 1)
+		m_checkpointPath = std::move(path);
+		m_checkpointInterval = flushIntervalSeconds;
+	}
+
+	bool ResumedFromCheckpoint() const noexcept { return m_resumed; }
+
+	// Makes Start() return, callable from any thread including from OnUpdate
+	void Quit() noexcept
+	{
+		if (m_backend)
 		{
-			DrawPixelAccumulate(x, y, red, green, blue, currentSampleIndex);
-			return;
+			m_backend->Quit();
 		}
-		const size_t index = (static_cast<size_t>(y) * m_windowContext->m_Width + x) * 3;
+	}
 
-		m_backBuffers[presentBufferIndex][index] = blue;
-		m_backBuffers[presentBufferIndex][index + 1] = green;
-		m_backBuffers[presentBufferIndex][index + 2] = red;
+	void DrawPixel(uint16_t x, uint16_t y, uint8_t red, uint8_t green, uint8_t blue, size_t currentSampleIndex = 1) noexcept
+	{
+		DrawPixel(x, y, Vec3f(red, green, blue) / 255.0f, currentSampleIndex);
 	}
 
 	void DrawPixel(uint16_t x, uint16_t y, const Vec3f& rgb, size_t currentSampleIndex = 1) noexcept
 	{
-		if (x >= m_windowContext->m_Width || y >= m_windowContext->m_Height)
+		if (x >= m_width || y >= m_height)
 		{
 			return;
 		}
 		if (currentSampleIndex > 1)
 		{
-			DrawPixelAccumulate(x, y, rgb, currentSampleIndex);
+			DrawPixelAccumulate(x, y, rgb);
 			return;
 		}
-		const size_t index = (static_cast<size_t>(y) * m_windowContext->m_Width + x) * 3;
 
-		m_backBuffers[presentBufferIndex][index] = static_cast<uint8_t>(rgb.b * 255.0f);
-		m_backBuffers[presentBufferIndex][index + 1] = static_cast<uint8_t>(rgb.g * 255.0f);
-		m_backBuffers[presentBufferIndex][index + 2] = static_cast<uint8_t>(rgb.r * 255.0f);
+		// the first sample restarts this pixel's accumulation
+		const size_t pixel = static_cast<size_t>(y) * m_width + x;
+		const size_t index = pixel * 3;
+		const float luminance = Luminance(rgb);
+		m_accumulationBuffer[index    ] = rgb.r;
+		m_accumulationBuffer[index + 1] = rgb.g;
+		m_accumulationBuffer[index + 2] = rgb.b;
+		m_luminanceSquaredBuffer[pixel] = luminance * luminance;
+		m_sampleCountBuffer[pixel] = 1;
+	}
+
+	uint32_t PixelSampleCount(size_t x, size_t y) const noexcept
+	{
+		return m_sampleCountBuffer[y * m_width + x];
 	}
 
-	void SetWindowTitle(std::wstring_view name) const noexcept
+	// standard error of the pixel mean relative to its luminance, from the running
+	// sums of luminance and squared luminance
+	float PixelRelativeError(size_t x, size_t y) const noexcept
 	{
-		SetWindowTextW(m_windowContext->m_hwnd, name.data());
+		const size_t pixel = y * m_width + x;
+		const uint32_t count = m_sampleCountBuffer[pixel];
+		if (count < 2)
+		{
+			return FLT_MAX;
+		}
+		const size_t index = pixel * 3;
+		const float mean = Luminance(Vec3f(m_accumulationBuffer[index], m_accumulationBuffer[index + 1], m_accumulationBuffer[index + 2])) / count;
+		const float variance = fmaxf(0.0f, (m_luminanceSquaredBuffer[pixel] / count - mean * mean) * count / (count - 1));
+		return sqrtf(variance / count) / fmaxf(mean, 1e-2f);
+	}
+
+	// Setting a window title can block on the UI thread, so the title is handed over
+	// and applied there
+	void SetWindowTitle(std::wstring_view name) noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_titleMutex);
+			m_pendingTitle = name;
+			m_titleChanged = true;
+		}
+		NotifyPresenter();
 	}
 
-	void SetWindowTitle(std::string_view name) const noexcept
+	void SetWindowTitle(std::string_view name) noexcept
 	{
-		SetWindowTextA(m_windowContext->m_hwnd, name.data());
+		SetWindowTitle(std::wstring(name.begin(), name.end()));
 	}
 
 	void ClearScreenEveryFrame(bool value) noexcept
@@ -103,6 +182,52 @@ public:
 		m_clearScreen = value;
 	}
 
+	void ResetAccumulation() noexcept
+	{
+		std::fill(m_accumulationBuffer.begin(), m_accumulationBuffer.end(), 0.0f);
+		std::fill(m_luminanceSquaredBuffer.begin(), m_luminanceSquaredBuffer.end(), 0.0f);
+		std::fill(m_sampleCountBuffer.begin(), m_sampleCountBuffer.end(), 0u);
+	}
+
+	// RGB bytes of the averaged accumulation, only valid while the render thread is
+	// stopped, i.e. once Start() returned
+	void ReadPixels(std::vector<uint8_t>& rgb) const
+	{
+		rgb.resize(m_sampleCountBuffer.size() * 3);
+		ResolveFrame(rgb, false);
+	}
+
+	// Streams the averaged accumulation to an image file, the format follows the
+	// extension. Only valid once Start() returned, like ReadPixels
+	bool WriteImage(const char* path) const
+	{
+		ImageWriter writer;
+		return writer.Open(path, ImageFormatFromPath(path), m_width, m_height) &&
+			writer.WriteRows(0, m_height, m_accumulationBuffer.data(), m_sampleCountBuffer.data()) &&
+			writer.Close();
+	}
+
+	// FNV-1a of the accumulated sums and sample counts, equal hashes mean the same
+	// image bit for bit. Only valid once Start() returned, like ReadPixels
+	uint64_t ImageHash() const noexcept
+	{
+		const uint64_t hash = HashBytes(m_accumulationBuffer.data(), m_accumulationBuffer.size_bytes());
+		return HashBytes(m_sampleCountBuffer.data(), m_sampleCountBuffer.size_bytes(), hash);
+	}
+
+	// while converged the render thread stops calling OnUpdate and sleeps until this is cleared
+	void SetConverged(bool value) noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_renderMutex);
+			m_converged = value;
+		}
+		if (!value)
+		{
+			m_renderWake.notify_one();
+		}
+	}
+
 protected:
 	// User-Utility
 	size_t canvasWidth = 800;
@@ -110,108 +235,159 @@ protected:
 	size_t currentFPS = 0;
 	size_t frameIndex = 1;
 
+	// RGB sums and sample counts, row major, canvasWidth pixels per row
+	const float* AccumulationData() const noexcept { return m_accumulationBuffer.data(); }
+	const uint32_t* SampleCountData() const noexcept { return m_sampleCountBuffer.data(); }
+
+	static float Luminance(const Vec3f& rgb) noexcept
+	{
+		return 0.2126f * rgb.r + 0.7152f * rgb.g + 0.0722f * rgb.b;
+	}
+
 private:
-	void CreateBackBuffers()
+	RESULT_VALUE CreateBackBuffers()
 	{
-		const LONG width = m_windowContext->m_Width;
-		const LONG height = m_windowContext->m_Height;
+		const size_t width = m_width;
+		const size_t height = m_height;
+		const size_t pixels = width * height;
 
-		for (size_t i = 0; i < BACKBUFFERCOUNT; i++)
+		for (uint32_t i = 0; i < 3; ++i)
 		{
-			if (m_backBuffers[i] == nullptr)
-			{
-				m_backBuffers[i] = new BYTE[width * height * 3]{ 0 };
-			}
+			m_frames.Slot(i).assign(pixels * 3, 0);
+		}
+
+		if (m_checkpointPath.empty())
+		{
+			m_accumulationStorage.assign(pixels * 3, 0.0f);
+			m_luminanceSquaredStorage.assign(pixels, 0.0f);
+			m_sampleCountStorage.assign(pixels, 0u);
+			m_accumulationBuffer = m_accumulationStorage;
+			m_luminanceSquaredBuffer = m_luminanceSquaredStorage;
+			m_sampleCountBuffer = m_sampleCountStorage;
+			return RESULT_VALUE::OK;
 		}
 
-		for (size_t i = 0; i < BACKBUFFERCOUNT; ++i)
+		bool existed = false;
+		if (!m_checkpointFile.Open(m_checkpointPath.c_str(), CheckpointHeader::FileSize(width, height), existed))
 		{
-			m_bitMapsHDC[i] = CreateCompatibleDC(m_windowContext->m_hdc);
-			m_bitMaps[i] = CreateCompatibleBitmap(m_bitMapsHDC[i], m_windowContext->m_Width, m_windowContext->m_Height);
-			SelectObject(m_bitMapsHDC[i], m_bitMaps[i]);
+			return existed ? RESULT_VALUE::CHECKPOINT_MISMATCH : RESULT_VALUE::CHECKPOINT_OPEN_FAILED;
 		}
 
-		m_accumulationBuffer.resize(static_cast<size_t>(width) * height * 3);
-		memset(m_accumulationBuffer.data(), 0, m_accumulationBuffer.size() * sizeof(float));
+		CheckpointHeader* header = static_cast<CheckpointHeader*>(m_checkpointFile.Data());
+		const uint64_t identity = CheckpointIdentity();
+		if (existed && !header->Matches(m_width, m_height, identity))
+		{
+			m_checkpointFile.Close();
+			return RESULT_VALUE::CHECKPOINT_MISMATCH;
+		}
+		if (!existed)
+		{
+			memcpy(header->magic, CheckpointHeader::MAGIC, sizeof(CheckpointHeader::MAGIC));
+			header->version = CheckpointHeader::VERSION;
+			header->width = m_width;
+			header->height = m_height;
+			header->sceneHash = identity;
+		}
+		m_checkpointHeader = header;
+		m_resumed = existed;
+
+		// a new file is zero filled, which is an empty accumulation
+		uint8_t* data = static_cast<uint8_t*>(m_checkpointFile.Data()) + sizeof(CheckpointHeader);
+		m_accumulationBuffer = std::span<float>(reinterpret_cast<float*>(data), pixels * 3);
+		data += pixels * 3 * sizeof(float);
+		m_luminanceSquaredBuffer = std::span<float>(reinterpret_cast<float*>(data), pixels);
+		data += pixels * sizeof(float);
+		m_sampleCountBuffer = std::span<uint32_t>(reinterpret_cast<uint32_t*>(data), pixels);
+		return RESULT_VALUE::OK;
 	}
-	void AdvanceBufferIndex() noexcept
+	// between frames the mapping holds a consistent state, the header is just stores
+	// into it and only the periodic flush touches the disk
+	void UpdateCheckpoint() noexcept
 	{
-		presentBufferIndex = (presentBufferIndex + 1) % BACKBUFFERCOUNT;
+		if (!m_checkpointHeader)
+		{
+			return;
+		}
+		m_checkpointHeader->frameIndex = frameIndex;
+		SaveCheckpoint(*m_checkpointHeader);
+
+		const auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<float>(now - m_lastCheckpointFlush).count() >= m_checkpointInterval)
+		{
+			m_checkpointFile.Flush();
+			m_lastCheckpointFlush = now;
+		}
 	}
-	void DrawPixelAccumulate(uint16_t x, uint16_t y, const Vec3f& color, size_t currentSampleIndex = 1) noexcept
+	static uint8_t ToByte(float value) noexcept
 	{
-		const size_t index = (static_cast<size_t>(y) * m_windowContext->m_Width + x) * 3;
+		return static_cast<uint8_t>(fminf(fmaxf(value, 0.0f), 1.0f) * 255.0f);
+	}
+	void DrawPixelAccumulate(uint16_t x, uint16_t y, const Vec3f& color) noexcept
+	{
+		const size_t pixel = static_cast<size_t>(y) * m_width + x;
+		const size_t index = pixel * 3;
+		const float luminance = Luminance(color);
 		m_accumulationBuffer[index    ] += color.r;
 		m_accumulationBuffer[index + 1] += color.g;
 		m_accumulationBuffer[index + 2] += color.b;
-
-		const Vec3f averagedColor =
-		{
-			m_accumulationBuffer[index    ] / (currentSampleIndex + 1),
-			m_accumulationBuffer[index + 1] / (currentSampleIndex + 1),
-			m_accumulationBuffer[index + 2] / (currentSampleIndex + 1)
-		};
-
-		m_backBuffers[presentBufferIndex][index    ] = static_cast<uint8_t>(averagedColor.b * 255.0f);
-		m_backBuffers[presentBufferIndex][index + 1] = static_cast<uint8_t>(averagedColor.g * 255.0f);
-		m_backBuffers[presentBufferIndex][index + 2] = static_cast<uint8_t>(averagedColor.r * 255.0f);
+		m_luminanceSquaredBuffer[pixel] += luminance * luminance;
+		++m_sampleCountBuffer[pixel];
 	}
-	void DrawPixelAccumulate(uint16_t x, uint16_t y, uint8_t red, uint8_t green, uint8_t blue, size_t currentSampleIndex = 1) noexcept
+	// Averages the accumulation into 8 bit pixels. Runs on the render thread after
+	// OnUpdate returned, so no worker is writing the accumulation meanwhile
+	void ResolveFrame(std::vector<uint8_t>& frame, bool bgr) const noexcept
 	{
-		const size_t index = (static_cast<size_t>(y) * m_windowContext->m_Width + x) * 3;
-		m_accumulationBuffer[index    ] += red;
-		m_accumulationBuffer[index + 1] += green;
-		m_accumulationBuffer[index + 2] += blue;
-
-		const Vec3f averagedColor =
+		const size_t red = bgr ? 2 : 0;
+		const size_t blue = bgr ? 0 : 2;
+		const size_t pixelCount = m_sampleCountBuffer.size();
+		for (size_t pixel = 0; pixel < pixelCount; ++pixel)
 		{
-			m_accumulationBuffer[index    ] / (currentSampleIndex + 1),
-			m_accumulationBuffer[index + 1] / (currentSampleIndex + 1),
-			m_accumulationBuffer[index + 2] / (currentSampleIndex + 1)
-		};
-
-		m_backBuffers[presentBufferIndex][index    ] = static_cast<uint8_t>(averagedColor.b);
-		m_backBuffers[presentBufferIndex][index + 1] = static_cast<uint8_t>(averagedColor.g);
-		m_backBuffers[presentBufferIndex][index + 2] = static_cast<uint8_t>(averagedColor.r);
+			const size_t index = pixel * 3;
+			const uint32_t count = m_sampleCountBuffer[pixel];
+			const float scale = count > 0 ? 1.0f / count : 0.0f;
+			frame[index + red ] = ToByte(m_accumulationBuffer[index    ] * scale);
+			frame[index + 1   ] = ToByte(m_accumulationBuffer[index + 1] * scale);
+			frame[index + blue] = ToByte(m_accumulationBuffer[index + 2] * scale);
+		}
 	}
-	void Present() noexcept
+	// one pending notification at a time, the UI thread always picks up the newest state
+	void NotifyPresenter() noexcept
 	{
-		const HDC hdcMem = m_bitMapsHDC[presentBufferIndex];
-		const HBITMAP hBitmap = m_bitMaps[presentBufferIndex];
-		BITMAPINFO bmi = {};
-		bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
-		bmi.bmiHeader.biWidth = m_windowContext->m_Width;
-		bmi.bmiHeader.biHeight = static_cast<LONG>(-m_windowContext->m_Height);
-		bmi.bmiHeader.biPlanes = 1;
-		bmi.bmiHeader.biBitCount = 24;
-		bmi.bmiHeader.biCompression = BI_RGB;
-
-		SelectObject(hdcMem, hBitmap);
-		SetDIBitsToDevice(m_windowContext->m_hdc, 0, 0, m_windowContext->m_Width, m_windowContext->m_Height, 0, 0, 0, m_windowContext->m_Height, m_backBuffers[presentBufferIndex], &bmi, DIB_RGB_COLORS);
-
-		AdvanceBufferIndex();
+		if (m_running && !m_presentPending.exchange(true))
+		{
+			m_backend->Notify();
+		}
 	}
-	void ClearScreen() noexcept
+	void OnPresentMessage() noexcept
 	{
-		const size_t bufferSize = (static_cast<size_t>(m_windowContext->m_Height) * m_windowContext->m_Width) * 3;
-		memset(m_backBuffers[presentBufferIndex], 0, bufferSize);
+		RT_PROFILE_SCOPE("Present");
+		m_presentPending = false;
+		{
+			std::lock_guard<std::mutex> lock(m_titleMutex);
+			if (m_titleChanged)
+			{
+				m_backend->SetTitle(m_pendingTitle);
+				m_titleChanged = false;
+			}
+		}
+		if (m_frames.Acquire())
+		{
+			m_backend->Present(m_frames.ReadBuffer().data(), m_width, m_height);
+		}
 	}
-	RESULT_VALUE Loop()
+	void RenderLoop() noexcept
 	{
+		PROFILER::SetThreadName("render");
 		auto last = std::chrono::steady_clock::now();
-		MSG msg = {};
 
-		while (true)
+		while (m_running)
 		{
-			while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+			if (m_converged)
 			{
-				if (msg.message == WM_QUIT)
-				{
-					return RESULT_VALUE::OK;
-				}
-
-				TranslateMessage(&msg);
-				DispatchMessageW(&msg);
+				std::unique_lock<std::mutex> lock(m_renderMutex);
+				m_renderWake.wait(lock, [this] { return !m_converged || !m_running; });
+				last = std::chrono::steady_clock::now();
+				continue;
 			}
 
 			const auto now = std::chrono::steady_clock::now();
@@ -221,31 +397,91 @@ private:
 
 			currentFPS = static_cast<size_t>(1.0 / deltaTime);
 
+			RT_PROFILE_SCOPE("Frame");
 			if (m_clearScreen)
 			{
-				ClearScreen();
+				ResetAccumulation();
+			}
+			{
+				RT_PROFILE_SCOPE("OnUpdate");
+				OnUpdate(deltaTime);
 			}
-			OnUpdate(deltaTime);
-			Present();
+			{
+				RT_PROFILE_SCOPE("ResolveFrame");
+				ResolveFrame(m_frames.WriteBuffer(), true);
+				m_frames.Publish();
+			}
+			NotifyPresenter();
 
 			++frameIndex;
+			RT_PROFILE_SCOPE("UpdateCheckpoint");
+			UpdateCheckpoint();
+		}
+	}
+	void StopRenderThread() noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_renderMutex);
+			m_running = false;
+		}
+		m_renderWake.notify_one();
+		if (m_renderThread.joinable())
+		{
+			m_renderThread.join();
 		}
+	}
+	// The calling thread only runs the backend and presents, tracing runs on the render thread
+	RESULT_VALUE Loop()
+	{
+		m_running = true;
+		m_lastCheckpointFlush = std::chrono::steady_clock::now();
+		PROFILER::SetThreadName("present");
+		m_renderThread = std::thread(&Application::RenderLoop, this);
+
+		m_backend->Run([this] { OnPresentMessage(); });
 
+		StopRenderThread();
+		if (m_checkpointHeader)
+		{
+			m_checkpointFile.Flush();
+		}
 		return RESULT_VALUE::OK;
 	}
 
 private:
-	// Content Window
-	std::unique_ptr<Platform::Window> m_windowContext = {nullptr};
+	// Platform
+	std::unique_ptr<Platform::Backend> m_backend;
+	uint16_t m_width = 0;
+	uint16_t m_height = 0;
 
 	// Data
-	RECT m_drawingRectangle;
-	size_t presentBufferIndex = 0;
-	HDC m_bitMapsHDC[BACKBUFFERCOUNT] = { nullptr };
-	HBITMAP m_bitMaps[BACKBUFFERCOUNT] = { nullptr };
-	BYTE* m_backBuffers[BACKBUFFERCOUNT] = { nullptr };
-	std::vector<float> m_accumulationBuffer;
+	TripleBuffer<std::vector<uint8_t>> m_frames;
+	std::span<float> m_accumulationBuffer;
+	std::span<float> m_luminanceSquaredBuffer;
+	std::span<uint32_t> m_sampleCountBuffer;
+	std::vector<float> m_accumulationStorage;
+	std::vector<float> m_luminanceSquaredStorage;
+	std::vector<uint32_t> m_sampleCountStorage;
+
+	// Checkpoint, the buffers above point into the mapping when it is open
+	std::string m_checkpointPath;
+	float m_checkpointInterval = 60.0f;
+	MappedFile m_checkpointFile;
+	CheckpointHeader* m_checkpointHeader = nullptr;
+	bool m_resumed = false;
+	std::chrono::steady_clock::time_point m_lastCheckpointFlush;
 	bool m_clearScreen = true;
+
+	// Threads
+	std::thread m_renderThread;
+	std::mutex m_renderMutex;
+	std::condition_variable m_renderWake;
+	std::atomic<bool> m_running = false;
+	std::atomic<bool> m_converged = false;
+	std::atomic<bool> m_presentPending = false;
+	std::mutex m_titleMutex;
+	std::wstring m_pendingTitle;
+	bool m_titleChanged = false;
 };
 
 #endif
\ No newline at end of file
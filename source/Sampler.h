@@ -0,0 +1,236 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "Random.h"
+#include <bit>
+
+enum class SamplerType : uint8_t
+{
+	INDEPENDENT,       // CounterHash, plain Monte Carlo
+	SOBOL,             // Owen-scrambled Sobol, padded in shuffled 4D blocks
+	RANK1_BLUE_NOISE,  // rank-1 lattice with a blue-noise dithered per pixel shift
+};
+
+namespace SAMPLING
+{
+	constexpr uint32_t ReverseBits(uint32_t x) noexcept
+	{
+		x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+		x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+		x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+		x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+		return (x >> 16) | (x << 16);
+	}
+
+	struct SobolDirections
+	{
+		uint32_t v[4][32] = {};
+	};
+
+	// Direction numbers for the first 4 Sobol dimensions (Joe & Kuo), dimension 0 is van der Corput
+	constexpr SobolDirections MakeSobolDirections() noexcept
+	{
+		SobolDirections table;
+		constexpr uint32_t degree[4] = { 0, 1, 2, 3 };
+		constexpr uint32_t coefficients[4] = { 0, 0, 1, 1 };
+		constexpr uint32_t initial[4][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 3, 0 }, { 1, 3, 1 } };
+
+		for (uint32_t bit = 0; bit < 32; ++bit)
+		{
+			table.v[0][bit] = 1u << (31 - bit);
+		}
+		for (uint32_t dim = 1; dim < 4; ++dim)
+		{
+			const uint32_t s = degree[dim];
+			for (uint32_t i = 0; i < s; ++i)
+			{
+				table.v[dim][i] = initial[dim][i] << (31 - i);
+			}
+			for (uint32_t i = s; i < 32; ++i)
+			{
+				uint32_t value = table.v[dim][i - s] ^ (table.v[dim][i - s] >> s);
+				for (uint32_t k = 1; k < s; ++k)
+				{
+					value ^= ((coefficients[dim] >> (s - 1 - k)) & 1u) * table.v[dim][i - k];
+				}
+				table.v[dim][i] = value;
+			}
+		}
+		return table;
+	}
+
+	inline constexpr SobolDirections SOBOL_DIRECTIONS = MakeSobolDirections();
+
+	// All four dimensions of point index, one step per set bit. Scrambled indices are
+	// random 32 bit words, so a test per bit would mispredict on every other one.
+	// Dimension 0 is the van der Corput sequence, the bit reversed index
+	inline void Sobol4(uint32_t index, uint32_t point[4]) noexcept
+	{
+		point[0] = ReverseBits(index);
+		uint32_t p1 = 0, p2 = 0, p3 = 0;
+		for (; index != 0; index &= index - 1)
+		{
+			const uint32_t bit = static_cast<uint32_t>(std::countr_zero(index));
+			p1 ^= SOBOL_DIRECTIONS.v[1][bit];
+			p2 ^= SOBOL_DIRECTIONS.v[2][bit];
+			p3 ^= SOBOL_DIRECTIONS.v[3][bit];
+		}
+		point[1] = p1;
+		point[2] = p2;
+		point[3] = p3;
+	}
+
+	// Hash based Owen scrambling (Burley 2020, "Practical Hash-based Owen Scrambling")
+	inline uint32_t LaineKarrasPermutation(uint32_t x, uint32_t seed) noexcept
+	{
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return x;
+	}
+
+	inline uint32_t NestedUniformScramble(uint32_t x, uint32_t seed) noexcept
+	{
+		return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+	}
+
+	// 32 bit fixed point generators of the R4 rank-1 lattice and of the R2 dither
+	inline constexpr uint32_t RANK1_GENERATORS[4] = { 0xDB4F0B91u, 0xBBE05633u, 0xA0F2EC75u, 0x89E18285u };
+	inline constexpr uint32_t DITHER_X = 0xC13FA9A9u;
+	inline constexpr uint32_t DITHER_Y = 0x91E10DA5u;
+};
+
+// Per path sampler. Each path vertex owns DIMENSIONS_PER_VERTEX consecutive dimensions,
+// vertex 0 being the camera (pixel jitter and lens), so the same decision always reads
+// the same dimension no matter how many values earlier vertices consumed. The sampler
+// type is a runtime tag switched on per value, it is a value type with no vtable
+class Sampler
+{
+public:
+	static constexpr uint32_t DIMENSIONS_PER_VERTEX = 8;
+
+	Sampler(SamplerType type, uint32_t x, uint32_t y, uint32_t width, uint32_t sampleIndex) noexcept :
+		m_type(type), m_pixel(y * width + x), m_sample(sampleIndex),
+		m_dither(x * SAMPLING::DITHER_X + y * SAMPLING::DITHER_Y)
+	{
+	}
+
+	void StartBounce(uint32_t vertex) noexcept
+	{
+		m_vertex = vertex;
+		m_dimension = 0;
+	}
+
+	float Next() noexcept
+	{
+		const uint32_t dimension = m_vertex * DIMENSIONS_PER_VERTEX + m_dimension++;
+		switch (m_type)
+		{
+			case SamplerType::SOBOL:
+			{
+				// every 4D block is its own Sobol sequence with a per pixel shuffled index,
+				// the block's seed and point are computed once, on its first value
+				const uint32_t block = dimension / 4;
+				const uint32_t component = dimension % 4;
+				if (block != m_sobolBlock)
+				{
+					m_sobolBlock = block;
+					m_sobolSeed = RANDOM::CounterHash(m_pixel, block, 0x50B01u, 0);
+					SAMPLING::Sobol4(SAMPLING::NestedUniformScramble(m_sample, m_sobolSeed), m_sobolPoint);
+				}
+				return RANDOM::ToUnitFloat(SAMPLING::NestedUniformScramble(m_sobolPoint[component], RANDOM::PCG_Hash(m_sobolSeed ^ component)));
+			}
+			case SamplerType::RANK1_BLUE_NOISE:
+			{
+				// the dither has a blue-noise like spectrum over the screen, the per dimension
+				// offset decorrelates blocks without changing that spectrum
+				const uint32_t offset = RANDOM::PCG_Hash(dimension + 0x9E3779B9u);
+				return RANDOM::ToUnitFloat(m_sample * SAMPLING::RANK1_GENERATORS[dimension % 4] + offset + m_dither);
+			}
+			default:
+				return RANDOM::ToUnitFloat(RANDOM::CounterHash(m_pixel, m_sample, m_vertex, m_dimension - 1));
+		}
+	}
+
+private:
+	SamplerType m_type;
+	uint32_t m_pixel;
+	uint32_t m_sample;
+	uint32_t m_dither;
+	uint32_t m_vertex = 0;
+	uint32_t m_dimension = 0;
+	uint32_t m_sobolBlock = UINT32_MAX; // 4D block m_sobolSeed and m_sobolPoint belong to
+	uint32_t m_sobolSeed = 0;
+	uint32_t m_sobolPoint[4] = {};
+};
+
+inline const char* SamplerName(SamplerType type) noexcept
+{
+	switch (type)
+	{
+		case SamplerType::SOBOL: return "Sobol";
+		case SamplerType::RANK1_BLUE_NOISE: return "Rank1";
+		default: return "Independent";
+	}
+}
+
+// Warps below consume a fixed number of dimensions (no rejection) so low discrepancy
+// samples keep their stratification
+
+// Russian roulette, paths survive with a probability equal to their max throughput
+// channel (capped so bright paths still end) and are reweighted by its inverse, so
+// the estimate stays unbiased
+inline bool SurviveRoulette(Sampler& sampler, Vec3f& throughput) noexcept
+{
+	const float survival = fminf(fmaxf(throughput.r, fmaxf(throughput.g, throughput.b)), 0.95f);
+	if (sampler.Next() >= survival)
+	{
+		return false;
+	}
+	throughput /= survival;
+	return true;
+}
+
+// multiple importance sampling weight of a sample drawn with pdf a, against a second
+// strategy that could have drawn it with pdf b
+inline float PowerHeuristic(float a, float b) noexcept
+{
+	return a * a / (a * a + b * b);
+}
+
+inline Vec3f SampleInUnitSphere(Sampler& sampler) noexcept
+{
+	const float z = 1.0f - 2.0f * sampler.Next();
+	const float phi = 6.283185307f * sampler.Next();
+	const float radius = cbrtf(sampler.Next());
+	const float ring = sqrtf(fmaxf(0.0f, 1.0f - z * z));
+	return radius * Vec3f(ring * cosf(phi), ring * sinf(phi), z);
+}
+
+// concentric mapping, keeps neighbouring samples neighbours on the lens
+inline Vec3f SampleInUnitDisk(Sampler& sampler) noexcept
+{
+	const float a = fmaf(2.0f, sampler.Next(), -1.0f);
+	const float b = fmaf(2.0f, sampler.Next(), -1.0f);
+	if (a == 0.0f && b == 0.0f)
+	{
+		return Vec3f(0.0f, 0.0f, 0.0f);
+	}
+
+	float radius, theta;
+	if (fabsf(a) > fabsf(b))
+	{
+		radius = a;
+		theta = 0.785398163f * (b / a);
+	}
+	else
+	{
+		radius = b;
+		theta = fmaf(-0.785398163f, a / b, 1.570796327f);
+	}
+	return Vec3f(radius * cosf(theta), radius * sinf(theta), 0.0f);
+}
+
+#endif
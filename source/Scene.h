@@ -0,0 +1,401 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <vector>
+#include "Hittable.h"
+#include "SphereSet.h"
+#include "Stats.h"
+#include "WideBVH.h"
+
+enum class AccelerationStructure : uint8_t
+{
+	LINEAR,
+	BVH2,
+	BVH4,
+	BVH8,
+};
+
+enum class PrimitiveType : uint8_t
+{
+	SPHERE,
+	CUSTOM, // user-defined shapes behind the virtual Hittable interface
+};
+
+// Type-segregated primitive store. Every primitive type lives in its own contiguous
+// array and is intersected by its own monomorphic loop, the tag is only looked at
+// while building. Hittable is kept as an adapter for user-defined shapes
+class Scene
+{
+public:
+	MaterialID AddMaterial(const Material& material)
+	{
+		m_materials.push_back(material);
+		return static_cast<MaterialID>(m_materials.size() - 1);
+	}
+
+	const Material& GetMaterial(MaterialID id) const noexcept
+	{
+		return m_materials[id];
+	}
+
+	uint32_t AddSphere(float radius, const Vec3f& center, MaterialID material)
+	{
+		return m_spheres.Add(radius, center, material);
+	}
+
+	uint32_t AddHittable(std::unique_ptr<Hittable> object)
+	{
+		m_custom.push_back(std::move(object));
+		return static_cast<uint32_t>(m_custom.size() - 1);
+	}
+
+	// Builds the BVHs over every primitive and reorders the per-type arrays so the
+	// primitives of each leaf are contiguous in each array. Indices returned by the
+	// Add* functions are invalidated
+	void Build();
+
+	void Clear()
+	{
+		m_materials.clear();
+		m_spheres.Clear();
+		m_custom.clear();
+		m_lights.clear();
+		m_skyIntensity = 1.0f;
+		m_sphereOffset.clear();
+		m_customOffset.clear();
+		m_bvh = BVH();
+		m_bvh4 = BVH4();
+#ifdef WIDE_BVH_HAS_8
+		m_bvh8 = BVH8();
+#endif
+	}
+
+	// LINEAR falls back to testing every primitive for every ray
+	void SetAccelerationStructure(AccelerationStructure value) noexcept
+	{
+#ifndef WIDE_BVH_HAS_8
+		if (value == AccelerationStructure::BVH8)
+		{
+			value = AccelerationStructure::BVH4;
+		}
+#endif
+		m_accelerationStructure = value;
+	}
+
+	AccelerationStructure GetAccelerationStructure() const noexcept { return m_accelerationStructure; }
+
+	const char* AccelerationStructureName() const noexcept
+	{
+		switch (m_accelerationStructure)
+		{
+			case AccelerationStructure::BVH2: return "BVH2";
+			case AccelerationStructure::BVH4: return "BVH4";
+			case AccelerationStructure::BVH8: return "BVH8";
+			default: return "Linear";
+		}
+	}
+
+	// fingerprint of the primitives and materials, custom shapes only contribute their bounds
+	uint64_t Hash() const noexcept;
+
+	// radiance of rays leaving the scene, a white to blue gradient over the direction's
+	// height scaled by the sky intensity
+	Vec3f Background(const Vec3f& direction) const noexcept
+	{
+		const Vec3f unit_direction = unit_vector(direction);
+		const float t = 0.5f * (unit_direction.y + 1.0f);
+		return ((1.0f - t) * Vec3f(1.0f, 1.0f, 1.0f) + t * Vec3f(0.5f, 0.7f, 1.0f)) * m_skyIntensity;
+	}
+
+	void SetSkyIntensity(float intensity) noexcept { m_skyIntensity = intensity; }
+
+	struct LightSample
+	{
+		Vec3f direction;  // unit vector towards the light
+		float distance;   // to the light's surface along direction
+		float pdf;        // solid angle density, light selection included
+		Vec3f radiance;
+	};
+
+	// Emissive spheres are the scene's lights, collected by Build. Custom shapes with
+	// an emissive material still glow but are only found by BSDF sampling
+	size_t LightCount() const noexcept { return m_lights.size(); }
+
+	// Picks a light uniformly and a direction inside the cone it subtends from p,
+	// uniform in solid angle. False when p is inside the chosen light
+	bool SampleLight(const Vec3f& p, Sampler& sampler, LightSample& sample) const noexcept
+	{
+		const float pick = sampler.Next();
+		const float u = sampler.Next();
+		const float v = sampler.Next();
+
+		const uint32_t light = m_lights[std::min(static_cast<size_t>(pick * static_cast<float>(m_lights.size())), m_lights.size() - 1)];
+		const Vec3f toCenter = m_spheres.Center(light) - p;
+		const float distance2 = dot(toCenter, toCenter);
+		const float radius = m_spheres.Radius(light);
+		if (distance2 <= radius * radius)
+		{
+			return false;
+		}
+
+		// 1 - cos of the cone's half angle, written to keep its precision for small or far lights
+		const float sin2Max = radius * radius / distance2;
+		const float oneMinusCosMax = sin2Max / (1.0f + sqrtf(1.0f - sin2Max));
+		const float oneMinusCos = u * oneMinusCosMax;
+		const float cosTheta = 1.0f - oneMinusCos;
+		const float sinTheta = sqrtf(fmaxf(0.0f, oneMinusCos * (2.0f - oneMinusCos)));
+		const float phi = 6.283185307f * v;
+
+		// orthonormal basis around the axis (Duff et al. 2017)
+		const float distance = sqrtf(distance2);
+		const Vec3f w = toCenter / distance;
+		const float sign = copysignf(1.0f, w.z);
+		const float a = -1.0f / (sign + w.z);
+		const float b = w.x * w.y * a;
+		const Vec3f tangent(1.0f + sign * w.x * w.x * a, sign * b, -sign * w.x);
+		const Vec3f bitangent(b, sign + w.y * w.y * a, -w.y);
+
+		sample.direction = unit_vector(tangent * (cosf(phi) * sinTheta) + bitangent * (sinf(phi) * sinTheta) + w * cosTheta);
+		sample.distance = distance * cosTheta - sqrtf(fmaxf(0.0f, radius * radius - distance2 * sinTheta * sinTheta));
+		sample.pdf = 1.0f / (6.283185307f * oneMinusCosMax * static_cast<float>(m_lights.size()));
+		sample.radiance = m_materials[m_spheres.GetMaterialID(light)].Emission;
+		return true;
+	}
+
+	// density SampleLight has for the direction from p that found the light hit,
+	// 0 for emitters it never samples
+	float LightPdf(const Vec3f& p, const HitRegistry& hit) const noexcept
+	{
+		if (hit.sphere == HitRegistry::NO_SPHERE)
+		{
+			return 0.0f;
+		}
+		const Vec3f toCenter = m_spheres.Center(hit.sphere) - p;
+		const float distance2 = dot(toCenter, toCenter);
+		const float radius = m_spheres.Radius(hit.sphere);
+		if (distance2 <= radius * radius)
+		{
+			return 0.0f;
+		}
+		const float sin2Max = radius * radius / distance2;
+		const float oneMinusCosMax = sin2Max / (1.0f + sqrtf(1.0f - sin2Max));
+		return 1.0f / (6.283185307f * oneMinusCosMax * static_cast<float>(m_lights.size()));
+	}
+
+	// Next event estimation at a Lambertian vertex: the shadow ray towards a sampled
+	// light and what it contributes per unit throughput if nothing blocks it, weighted
+	// against BSDF sampling. False when the sample cannot contribute
+	bool SampleDirectLight(const HitRegistry& rec, const Material& material, Sampler& sampler, Ray& shadowRay, float& shadowDistance, Vec3f& contribution) const noexcept
+	{
+		LightSample light;
+		if (!SampleLight(rec.p, sampler, light))
+		{
+			return false;
+		}
+		const float bsdfPdf = Material::LambertianPdf(rec.normal, light.direction);
+		if (bsdfPdf <= 0.0f)
+		{
+			return false;
+		}
+
+		shadowRay = Ray(rec.p, light.direction);
+		shadowDistance = light.distance * 0.999f; // stops short of the light itself
+		// the BSDF times cosine is Albedo * bsdfPdf, see Material::LambertianPdf
+		contribution = (PowerHeuristic(light.pdf, bsdfPdf) * bsdfPdf / light.pdf) * (material.Albedo * light.radiance);
+		return true;
+	}
+
+	// MIS weight of emission found by a BSDF ray leaving from with density bsdfPdf,
+	// 0 when the vertex it left did not sample lights
+	float EmissionWeight(const Vec3f& from, float bsdfPdf, const HitRegistry& hit) const noexcept
+	{
+		return bsdfPdf > 0.0f ? PowerHeuristic(bsdfPdf, LightPdf(from, hit)) : 1.0f;
+	}
+
+	size_t PrimitiveCount() const noexcept { return m_spheres.Size() + m_custom.size(); }
+	const SphereSet& Spheres() const noexcept { return m_spheres; }
+
+	bool ClosestHit(const Ray& r, float t_min, float t_max, HitRegistry* rec) const noexcept
+	{
+		const auto intersectLeaf = [&](uint32_t first, uint32_t count, float& closest) noexcept -> bool
+			{
+				return IntersectRange(r, rec, t_min, closest, m_sphereOffset[first], m_sphereOffset[first + count], m_customOffset[first], m_customOffset[first + count]);
+			};
+
+		switch (m_accelerationStructure)
+		{
+			case AccelerationStructure::BVH2:
+				return m_bvh.Traverse(r, t_min, t_max, intersectLeaf);
+			case AccelerationStructure::BVH4:
+				return m_bvh4.Traverse(r, t_min, t_max, intersectLeaf);
+#ifdef WIDE_BVH_HAS_8
+			case AccelerationStructure::BVH8:
+				return m_bvh8.Traverse(r, t_min, t_max, intersectLeaf);
+#endif
+			default:
+				return IntersectRange(r, rec, t_min, t_max, 0, static_cast<uint32_t>(m_spheres.Size()), 0, static_cast<uint32_t>(m_custom.size()));
+		}
+	}
+
+	// Any primitive hit inside (t_min, t_max), for shadow and visibility rays. Stops at
+	// the first hit found and fills no HitRegistry
+	bool Occluded(const Ray& r, float t_min, float t_max) const noexcept
+	{
+		const auto occludedLeaf = [&](uint32_t first, uint32_t count) noexcept -> bool
+			{
+				return OccludedRange(r, t_min, t_max, m_sphereOffset[first], m_sphereOffset[first + count], m_customOffset[first], m_customOffset[first + count]);
+			};
+
+		switch (m_accelerationStructure)
+		{
+			case AccelerationStructure::BVH2:
+				return m_bvh.TraverseAny(r, t_min, t_max, occludedLeaf);
+			case AccelerationStructure::BVH4:
+				return m_bvh4.TraverseAny(r, t_min, t_max, occludedLeaf);
+#ifdef WIDE_BVH_HAS_8
+			case AccelerationStructure::BVH8:
+				return m_bvh8.TraverseAny(r, t_min, t_max, occludedLeaf);
+#endif
+			default:
+				return OccludedRange(r, t_min, t_max, 0, static_cast<uint32_t>(m_spheres.Size()), 0, static_cast<uint32_t>(m_custom.size()));
+		}
+	}
+
+	// packets traverse the selected BVH, the linear fallback has none to traverse
+	bool PacketsSupported() const noexcept
+	{
+		return RAY_PACKETS && m_accelerationStructure != AccelerationStructure::LINEAR && !m_bvh.Empty();
+	}
+
+#if RAY_PACKETS
+	// Closest hits of up to RayPacket::SIZE rays traced together, the same hits
+	// ClosestHit finds for each of them. hits[i].t stays negative for rays that miss
+	void ClosestHitPacket(const Ray* rays, uint32_t rayCount, float t_min, float t_max, HitRegistry* hits) const noexcept
+	{
+		RayPacket packet;
+		for (uint32_t lane = 0; lane < rayCount; ++lane)
+		{
+			packet.Set(lane, rays[lane], t_max);
+			hits[lane] = HitRegistry();
+		}
+		packet.Finish();
+
+		const auto intersectLeaf = [&](uint32_t first, uint32_t count, uint32_t laneMask) noexcept
+			{
+				const uint32_t sphereBegin = m_sphereOffset[first], sphereEnd = m_sphereOffset[first + count];
+				const uint32_t customBegin = m_customOffset[first], customEnd = m_customOffset[first + count];
+				RT_STAT_ADD(STATS::PRIMITIVE_TESTS, std::popcount(laneMask) * ((sphereEnd - sphereBegin) + (customEnd - customBegin)));
+
+				if (sphereEnd > sphereBegin)
+				{
+					m_spheres.HITPacket(packet, laneMask, t_min, sphereBegin, sphereEnd - sphereBegin);
+				}
+				for (uint32_t i = customBegin; i < customEnd; ++i)
+				{
+					for (uint32_t lane = 0; lane < RayPacket::SIZE; ++lane)
+					{
+						if ((laneMask & (1u << lane)) && m_custom[i]->HIT(packet.LaneRay(lane), &hits[lane], t_min, packet.tMax[lane]))
+						{
+							packet.tMax[lane] = hits[lane].t;
+							packet.sphere[lane] = RayPacket::CUSTOM_HIT;
+							hits[lane].sphere = HitRegistry::NO_SPHERE;
+						}
+					}
+				}
+			};
+
+		switch (m_accelerationStructure)
+		{
+			case AccelerationStructure::BVH4:
+				m_bvh4.TraversePacket(packet, t_min, intersectLeaf);
+				break;
+#ifdef WIDE_BVH_HAS_8
+			case AccelerationStructure::BVH8:
+				m_bvh8.TraversePacket(packet, t_min, intersectLeaf);
+				break;
+#endif
+			default:
+				m_bvh.TraversePacket(packet, t_min, intersectLeaf);
+				break;
+		}
+
+		for (uint32_t lane = 0; lane < rayCount; ++lane)
+		{
+			if (packet.sphere[lane] >= 0)
+			{
+				m_spheres.Record(rays[lane], packet.tMax[lane], static_cast<uint32_t>(packet.sphere[lane]), &hits[lane]);
+			}
+			else if (packet.sphere[lane] != RayPacket::CUSTOM_HIT)
+			{
+				hits[lane] = HitRegistry();
+			}
+		}
+	}
+#endif
+
+private:
+	bool OccludedRange(const Ray& r, float t_min, float t_max, uint32_t sphereBegin, uint32_t sphereEnd, uint32_t customBegin, uint32_t customEnd) const noexcept
+	{
+		RT_STAT_ADD(STATS::PRIMITIVE_TESTS, (sphereEnd - sphereBegin) + (customEnd - customBegin));
+
+		if (sphereEnd > sphereBegin && m_spheres.Occluded(r, t_min, t_max, sphereBegin, sphereEnd - sphereBegin))
+		{
+			return true;
+		}
+		for (uint32_t i = customBegin; i < customEnd; ++i)
+		{
+			if (m_custom[i]->Occluded(r, t_min, t_max))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool IntersectRange(const Ray& r, HitRegistry* rec, float t_min, float& closest, uint32_t sphereBegin, uint32_t sphereEnd, uint32_t customBegin, uint32_t customEnd) const noexcept
+	{
+		RT_STAT_ADD(STATS::PRIMITIVE_TESTS, (sphereEnd - sphereBegin) + (customEnd - customBegin));
+
+		bool hitAnything = false;
+		if (sphereEnd > sphereBegin && m_spheres.HIT(r, rec, t_min, closest, sphereBegin, sphereEnd - sphereBegin))
+		{
+			hitAnything = true;
+			closest = rec->t;
+		}
+		for (uint32_t i = customBegin; i < customEnd; ++i)
+		{
+			if (m_custom[i]->HIT(r, rec, t_min, closest))
+			{
+				hitAnything = true;
+				closest = rec->t;
+				rec->sphere = HitRegistry::NO_SPHERE;
+			}
+		}
+		return hitAnything;
+	}
+
+	std::vector<Material> m_materials;
+	SphereSet m_spheres;
+	std::vector<std::unique_ptr<Hittable>> m_custom;
+	std::vector<uint32_t> m_lights; // emissive spheres, SphereSet indices
+	float m_skyIntensity = 1.0f;
+
+	// prefix counts over the BVH primitive order, leaf [first, first + count) owns
+	// spheres [m_sphereOffset[first], m_sphereOffset[first + count]) and likewise for custom
+	std::vector<uint32_t> m_sphereOffset;
+	std::vector<uint32_t> m_customOffset;
+
+	BVH m_bvh;
+	BVH4 m_bvh4;
+#ifdef WIDE_BVH_HAS_8
+	BVH8 m_bvh8;
+	AccelerationStructure m_accelerationStructure = AccelerationStructure::BVH8;
+#else
+	AccelerationStructure m_accelerationStructure = AccelerationStructure::BVH4;
+#endif
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef _WIN32
+using SocketHandle = uintptr_t;
+#else
+using SocketHandle = int;
+#endif
+
+// Blocking TCP stream with whole buffer send/receive, just enough for the
+// distributed renderer's length prefixed messages
+class Socket
+{
+public:
+	Socket() noexcept = default;
+	~Socket() { Close(); }
+
+	Socket(Socket&& other) noexcept : m_handle(other.m_handle) { other.m_handle = INVALID; }
+	Socket& operator=(Socket&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			m_handle = other.m_handle;
+			other.m_handle = INVALID;
+		}
+		return *this;
+	}
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+
+	// process wide setup (Winsock), call once before using sockets
+	static bool Initialize() noexcept;
+
+	// port 0 picks a free port, see LocalPort()
+	bool Listen(uint16_t port, int backlog = 64) noexcept;
+	Socket Accept() noexcept;
+	bool Connect(const char* host, uint16_t port) noexcept;
+
+	bool SendAll(const void* data, size_t size) noexcept;
+	// false if the peer closed the connection or failed before size bytes arrived
+	bool ReceiveAll(void* data, size_t size) noexcept;
+	// a receive that waits longer than timeoutMs for data fails, 0 waits forever
+	bool SetReceiveTimeout(int timeoutMs) noexcept;
+
+	void Close() noexcept;
+	bool IsValid() const noexcept { return m_handle != INVALID; }
+	uint16_t LocalPort() const noexcept;
+
+	// Waits up to timeoutMs until one of sockets has data (or was closed), ready[i]
+	// flags them. Returns the number of ready sockets, negative on error
+	static int WaitReadable(const std::vector<const Socket*>& sockets, std::vector<uint8_t>& ready, int timeoutMs) noexcept;
+
+private:
+#ifdef _WIN32
+	static constexpr SocketHandle INVALID = ~static_cast<SocketHandle>(0);
+#else
+	static constexpr SocketHandle INVALID = -1;
+#endif
+
+	explicit Socket(SocketHandle handle) noexcept : m_handle(handle) {}
+
+	SocketHandle m_handle = INVALID;
+};
+
+#endif
@@ -7,9 +7,9 @@
 class Sphere final : public Hittable
 {
 public:
-	constexpr Sphere(float r = 1.0f, const Vec3f& pos = Vec3f(), const Material& mat = Material()) : center(pos), radius(r)
+	constexpr Sphere(float r = 1.0f, const Vec3f& pos = Vec3f(), MaterialID mat = 0) : center(pos), radius(r)
 	{
-		material = mat;
+		materialID = mat;
 	}
 	~Sphere(){}
 
@@ -30,7 +30,7 @@ public:
 				rec->t = t;
 				rec->p = r.PointAtT(t);
 				rec->normal = (rec->p - center) / radius;
-				rec->material = material;
+				rec->materialID = materialID;
 
 				return true;
 			}
@@ -41,7 +41,7 @@ public:
 				rec->t = t;
 				rec->p = r.PointAtT(t);
 				rec->normal = (rec->p - center) / radius;
-				rec->material = material;
+				rec->materialID = materialID;
 
 				return true;
 			}
@@ -49,6 +49,30 @@ public:
 		return false;
 	}
 
+	bool Occluded(const Ray& r, float t_min, float t_max) const noexcept override
+	{
+		Vec3f oc = r.origin - center;
+		float a = dot(r.direction, r.direction);
+		float b = dot(oc, r.direction);
+		float c = dot(oc,oc) - radius*radius;
+		float discriminant = b * b - a * c;
+
+		if (discriminant > 0)
+		{
+			const float sqrtD = sqrtf(discriminant);
+			const float tNear = (-b - sqrtD) / a;
+			const float tFar = (-b + sqrtD) / a;
+			return (tNear < t_max && tNear > t_min) || (tFar < t_max && tFar > t_min);
+		}
+		return false;
+	}
+
+	AABB BoundingBox() const noexcept override
+	{
+		const Vec3f extent(radius, radius, radius);
+		return AABB(center - extent, center + extent);
+	}
+
 	Vec3f center;
 	float radius;
 };
@@ -0,0 +1,388 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include <vector>
+#include <cstdint>
+#include <cfloat>
+#include <immintrin.h>
+#include "Material.h"
+#include "AABB.h"
+#include "RayPacket.h"
+
+#if defined(__AVX512F__)
+#define SPHERE_SET_LANES 16
+#elif defined(__AVX2__)
+#define SPHERE_SET_LANES 8
+#else
+#define SPHERE_SET_LANES 1
+#endif
+
+// Packed spheres stored as separate center x/y/z and radius arrays. HIT runs the
+// same math as Sphere::HIT against SPHERE_SET_LANES spheres per instruction and
+// reduces to the nearest t, Occluded stops at the first hit instead. The range
+// overloads are the BVH leaf kernels, the full overload is a brute force scan for
+// scenes without an acceleration structure
+class SphereSet
+{
+public:
+	// arrays are padded so a vector load starting anywhere in [0, Size()) stays in bounds
+	static constexpr size_t PADDING = 16;
+
+	SphereSet() noexcept { Clear(); }
+
+	void Clear() noexcept
+	{
+		m_count = 0;
+		m_centerX.assign(PADDING, 0.0f);
+		m_centerY.assign(PADDING, 0.0f);
+		m_centerZ.assign(PADDING, 0.0f);
+		m_radius.assign(PADDING, 0.0f);
+		m_materialIDs.clear();
+	}
+
+	uint32_t Add(float radius, const Vec3f& center, MaterialID material)
+	{
+		m_centerX.resize(m_count + 1 + PADDING);
+		m_centerY.resize(m_count + 1 + PADDING);
+		m_centerZ.resize(m_count + 1 + PADDING);
+		m_radius.resize(m_count + 1 + PADDING);
+
+		m_centerX[m_count] = center.x;
+		m_centerY[m_count] = center.y;
+		m_centerZ[m_count] = center.z;
+		m_radius[m_count] = radius;
+		m_materialIDs.push_back(material);
+
+		return static_cast<uint32_t>(m_count++);
+	}
+
+	size_t Size() const noexcept { return m_count; }
+	Vec3f Center(size_t i) const noexcept { return Vec3f(m_centerX[i], m_centerY[i], m_centerZ[i]); }
+	float Radius(size_t i) const noexcept { return m_radius[i]; }
+	MaterialID GetMaterialID(size_t i) const noexcept { return m_materialIDs[i]; }
+
+	AABB BoundingBox(size_t i) const noexcept
+	{
+		const Vec3f extent(m_radius[i], m_radius[i], m_radius[i]);
+		return AABB(Center(i) - extent, Center(i) + extent);
+	}
+
+	// new slot i holds old sphere order[i], used to lay spheres out in BVH leaf order
+	void Reorder(const std::vector<uint32_t>& order)
+	{
+		SphereSet sorted;
+		for (const uint32_t index : order)
+		{
+			sorted.Add(m_radius[index], Center(index), m_materialIDs[index]);
+		}
+		*this = std::move(sorted);
+	}
+
+	bool HIT(const Ray& r, HitRegistry* rec, float t_min, float t_max) const noexcept
+	{
+		return HIT(r, rec, t_min, t_max, 0, static_cast<uint32_t>(m_count));
+	}
+
+	bool HIT(const Ray& r, HitRegistry* rec, float t_min, float t_max, uint32_t first, uint32_t count) const noexcept
+	{
+		float closest = t_max;
+		const int32_t index = NearestSphere(r, t_min, closest, first, count);
+		if (index < 0)
+		{
+			return false;
+		}
+
+		Record(r, closest, static_cast<uint32_t>(index), rec);
+		return true;
+	}
+
+	void Record(const Ray& r, float t, uint32_t index, HitRegistry* rec) const noexcept
+	{
+		rec->t = t;
+		rec->p = r.PointAtT(t);
+		rec->normal = (rec->p - Center(index)) / m_radius[index];
+		rec->materialID = m_materialIDs[index];
+		rec->sphere = index;
+	}
+
+	// Any sphere of the range hit inside (t_min, t_max), the arithmetic of HIT without
+	// the reduction: returns after the first block of SPHERE_SET_LANES with a hit
+	bool Occluded(const Ray& r, float t_min, float t_max, uint32_t first, uint32_t count) const noexcept
+	{
+		const uint32_t end = first + count;
+		const float a = DirectionDot(r.direction);
+
+#if SPHERE_SET_LANES == 16
+		const __m512 ox = _mm512_set1_ps(r.origin.x), oy = _mm512_set1_ps(r.origin.y), oz = _mm512_set1_ps(r.origin.z);
+		const __m512 dx = _mm512_set1_ps(r.direction.x), dy = _mm512_set1_ps(r.direction.y), dz = _mm512_set1_ps(r.direction.z);
+		const __m512 va = _mm512_set1_ps(a), invA = _mm512_set1_ps(1.0f / a), tMin = _mm512_set1_ps(t_min), tMax = _mm512_set1_ps(t_max);
+		__m512i laneIndex = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int32_t>(first)), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+		const __m512i endIndex = _mm512_set1_epi32(static_cast<int32_t>(end));
+
+		for (uint32_t i = first; i < end; i += 16)
+		{
+			const __m512 ocx = _mm512_sub_ps(ox, _mm512_loadu_ps(&m_centerX[i]));
+			const __m512 ocy = _mm512_sub_ps(oy, _mm512_loadu_ps(&m_centerY[i]));
+			const __m512 ocz = _mm512_sub_ps(oz, _mm512_loadu_ps(&m_centerZ[i]));
+			const __m512 radius = _mm512_loadu_ps(&m_radius[i]);
+
+			const __m512 b = _mm512_fmadd_ps(ocx, dx, _mm512_fmadd_ps(ocy, dy, _mm512_mul_ps(ocz, dz)));
+			const __m512 c = _mm512_fmsub_ps(ocx, ocx, _mm512_fnmadd_ps(ocy, ocy, _mm512_fnmadd_ps(ocz, ocz, _mm512_mul_ps(radius, radius))));
+			const __m512 discriminant = _mm512_fmsub_ps(b, b, _mm512_mul_ps(va, c));
+			const __mmask16 valid = _mm512_cmp_ps_mask(discriminant, _mm512_setzero_ps(), _CMP_GT_OQ) & _mm512_cmplt_epi32_mask(laneIndex, endIndex);
+
+			const __m512 sqrtD = _mm512_sqrt_ps(_mm512_max_ps(discriminant, _mm512_setzero_ps()));
+			const __m512 tNear = _mm512_mul_ps(_mm512_sub_ps(_mm512_sub_ps(_mm512_setzero_ps(), b), sqrtD), invA);
+			const __m512 tFar = _mm512_mul_ps(_mm512_add_ps(_mm512_sub_ps(_mm512_setzero_ps(), b), sqrtD), invA);
+			const __m512 t = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(tNear, tMin, _CMP_GT_OQ), tFar, tNear);
+
+			if (valid & _mm512_cmp_ps_mask(t, tMin, _CMP_GT_OQ) & _mm512_cmp_ps_mask(t, tMax, _CMP_LT_OQ))
+			{
+				return true;
+			}
+			laneIndex = _mm512_add_epi32(laneIndex, _mm512_set1_epi32(16));
+		}
+#elif SPHERE_SET_LANES == 8
+		const __m256 ox = _mm256_set1_ps(r.origin.x), oy = _mm256_set1_ps(r.origin.y), oz = _mm256_set1_ps(r.origin.z);
+		const __m256 dx = _mm256_set1_ps(r.direction.x), dy = _mm256_set1_ps(r.direction.y), dz = _mm256_set1_ps(r.direction.z);
+		const __m256 va = _mm256_set1_ps(a), invA = _mm256_set1_ps(1.0f / a), tMin = _mm256_set1_ps(t_min), tMax = _mm256_set1_ps(t_max);
+		const __m256 zero = _mm256_setzero_ps();
+		__m256i laneIndex = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(first)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		const __m256i endIndex = _mm256_set1_epi32(static_cast<int32_t>(end));
+
+		for (uint32_t i = first; i < end; i += 8)
+		{
+			const __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(&m_centerX[i]));
+			const __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(&m_centerY[i]));
+			const __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(&m_centerZ[i]));
+			const __m256 radius = _mm256_loadu_ps(&m_radius[i]);
+
+			const __m256 b = _mm256_fmadd_ps(ocx, dx, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocz, dz)));
+			const __m256 c = _mm256_fmsub_ps(ocx, ocx, _mm256_fnmadd_ps(ocy, ocy, _mm256_fnmadd_ps(ocz, ocz, _mm256_mul_ps(radius, radius))));
+			const __m256 discriminant = _mm256_fmsub_ps(b, b, _mm256_mul_ps(va, c));
+			const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GT_OQ), _mm256_castsi256_ps(_mm256_cmpgt_epi32(endIndex, laneIndex)));
+
+			const __m256 sqrtD = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+			const __m256 minusB = _mm256_sub_ps(zero, b);
+			const __m256 tNear = _mm256_mul_ps(_mm256_sub_ps(minusB, sqrtD), invA);
+			const __m256 tFar = _mm256_mul_ps(_mm256_add_ps(minusB, sqrtD), invA);
+			const __m256 t = _mm256_blendv_ps(tFar, tNear, _mm256_cmp_ps(tNear, tMin, _CMP_GT_OQ));
+
+			const __m256 hit = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, tMin, _CMP_GT_OQ), _mm256_cmp_ps(t, tMax, _CMP_LT_OQ)));
+			if (_mm256_movemask_ps(hit))
+			{
+				return true;
+			}
+			laneIndex = _mm256_add_epi32(laneIndex, _mm256_set1_epi32(8));
+		}
+#else
+		for (uint32_t i = first; i < end; ++i)
+		{
+			const Vec3f oc = r.origin - Center(i);
+			const float b = dot(oc, r.direction);
+			const float c = dot(oc, oc) - m_radius[i] * m_radius[i];
+			const float discriminant = b * b - a * c;
+			if (discriminant > 0)
+			{
+				const float sqrtD = sqrtf(discriminant);
+				float t = (-b - sqrtD) / a;
+				if (t <= t_min)
+				{
+					t = (-b + sqrtD) / a;
+				}
+				if (t > t_min && t < t_max)
+				{
+					return true;
+				}
+			}
+		}
+#endif
+		return false;
+	}
+
+#if RAY_PACKETS
+	// Every sphere of the range against the lanes in laneMask, one sphere per step
+	// and one ray per lane, the transpose of NearestSphere with the same arithmetic,
+	// bit for bit. Closer hits shrink packet.tMax and set packet.sphere
+	void HITPacket(RayPacket& packet, uint32_t laneMask, float t_min, uint32_t first, uint32_t count) const noexcept
+	{
+		const __m256 ox = _mm256_load_ps(packet.originX), oy = _mm256_load_ps(packet.originY), oz = _mm256_load_ps(packet.originZ);
+		const __m256 dx = _mm256_load_ps(packet.directionX), dy = _mm256_load_ps(packet.directionY), dz = _mm256_load_ps(packet.directionZ);
+		const __m256 a = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+		const __m256 invA = _mm256_div_ps(_mm256_set1_ps(1.0f), a);
+		const __m256 tMin = _mm256_set1_ps(t_min);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		const __m256 active = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int32_t>(laneMask)), laneBits), laneBits));
+
+		__m256 bestT = _mm256_load_ps(packet.tMax);
+		__m256i bestSphere = _mm256_load_si256(reinterpret_cast<const __m256i*>(packet.sphere));
+
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			const __m256 ocx = _mm256_sub_ps(ox, _mm256_set1_ps(m_centerX[i]));
+			const __m256 ocy = _mm256_sub_ps(oy, _mm256_set1_ps(m_centerY[i]));
+			const __m256 ocz = _mm256_sub_ps(oz, _mm256_set1_ps(m_centerZ[i]));
+			const __m256 radius = _mm256_set1_ps(m_radius[i]);
+
+			const __m256 b = _mm256_fmadd_ps(ocx, dx, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocz, dz)));
+			const __m256 c = _mm256_fmsub_ps(ocx, ocx, _mm256_fnmadd_ps(ocy, ocy, _mm256_fnmadd_ps(ocz, ocz, _mm256_mul_ps(radius, radius))));
+			const __m256 discriminant = _mm256_fmsub_ps(b, b, _mm256_mul_ps(a, c));
+			const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GT_OQ), active);
+
+			const __m256 sqrtD = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+			const __m256 minusB = _mm256_sub_ps(zero, b);
+			const __m256 tNear = _mm256_mul_ps(_mm256_sub_ps(minusB, sqrtD), invA);
+			const __m256 tFar = _mm256_mul_ps(_mm256_add_ps(minusB, sqrtD), invA);
+			const __m256 t = _mm256_blendv_ps(tFar, tNear, _mm256_cmp_ps(tNear, tMin, _CMP_GT_OQ));
+
+			const __m256 hit = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, tMin, _CMP_GT_OQ), _mm256_cmp_ps(t, bestT, _CMP_LT_OQ)));
+			bestT = _mm256_blendv_ps(bestT, t, hit);
+			bestSphere = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestSphere), _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int32_t>(i))), hit));
+		}
+
+		_mm256_store_ps(packet.tMax, bestT);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(packet.sphere), bestSphere);
+	}
+#endif
+
+private:
+	// The quadratic terms are written as explicit FMAs, the same ones in every kernel:
+	// left to the compiler, mul/add pairs contract differently in scalar and vector
+	// code, and the packet and single ray paths would find slightly different t
+	static float DirectionDot(const Vec3f& d) noexcept
+	{
+		return fmaf(d.x, d.x, fmaf(d.y, d.y, d.z * d.z));
+	}
+
+	int32_t NearestSphere(const Ray& r, float t_min, float& t_max, uint32_t first, uint32_t count) const noexcept
+	{
+		const uint32_t end = first + count;
+		const float a = DirectionDot(r.direction);
+		int32_t bestIndex = -1;
+
+#if SPHERE_SET_LANES == 16
+		const __m512 ox = _mm512_set1_ps(r.origin.x), oy = _mm512_set1_ps(r.origin.y), oz = _mm512_set1_ps(r.origin.z);
+		const __m512 dx = _mm512_set1_ps(r.direction.x), dy = _mm512_set1_ps(r.direction.y), dz = _mm512_set1_ps(r.direction.z);
+		const __m512 va = _mm512_set1_ps(a), invA = _mm512_set1_ps(1.0f / a), tMin = _mm512_set1_ps(t_min);
+		__m512 bestT = _mm512_set1_ps(t_max);
+		__m512i bestLane = _mm512_set1_epi32(-1);
+		__m512i laneIndex = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int32_t>(first)), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+		const __m512i endIndex = _mm512_set1_epi32(static_cast<int32_t>(end));
+
+		for (uint32_t i = first; i < end; i += 16)
+		{
+			const __m512 ocx = _mm512_sub_ps(ox, _mm512_loadu_ps(&m_centerX[i]));
+			const __m512 ocy = _mm512_sub_ps(oy, _mm512_loadu_ps(&m_centerY[i]));
+			const __m512 ocz = _mm512_sub_ps(oz, _mm512_loadu_ps(&m_centerZ[i]));
+			const __m512 radius = _mm512_loadu_ps(&m_radius[i]);
+
+			const __m512 b = _mm512_fmadd_ps(ocx, dx, _mm512_fmadd_ps(ocy, dy, _mm512_mul_ps(ocz, dz)));
+			const __m512 c = _mm512_fmsub_ps(ocx, ocx, _mm512_fnmadd_ps(ocy, ocy, _mm512_fnmadd_ps(ocz, ocz, _mm512_mul_ps(radius, radius))));
+			const __m512 discriminant = _mm512_fmsub_ps(b, b, _mm512_mul_ps(va, c));
+			const __mmask16 valid = _mm512_cmp_ps_mask(discriminant, _mm512_setzero_ps(), _CMP_GT_OQ) & _mm512_cmplt_epi32_mask(laneIndex, endIndex);
+
+			const __m512 sqrtD = _mm512_sqrt_ps(_mm512_max_ps(discriminant, _mm512_setzero_ps()));
+			const __m512 tNear = _mm512_mul_ps(_mm512_sub_ps(_mm512_sub_ps(_mm512_setzero_ps(), b), sqrtD), invA);
+			const __m512 tFar = _mm512_mul_ps(_mm512_add_ps(_mm512_sub_ps(_mm512_setzero_ps(), b), sqrtD), invA);
+			const __m512 t = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(tNear, tMin, _CMP_GT_OQ), tFar, tNear);
+
+			const __mmask16 hit = valid & _mm512_cmp_ps_mask(t, tMin, _CMP_GT_OQ) & _mm512_cmp_ps_mask(t, bestT, _CMP_LT_OQ);
+			bestT = _mm512_mask_blend_ps(hit, bestT, t);
+			bestLane = _mm512_mask_blend_epi32(hit, bestLane, laneIndex);
+			laneIndex = _mm512_add_epi32(laneIndex, _mm512_set1_epi32(16));
+		}
+
+		alignas(64) float lanesT[16];
+		alignas(64) int32_t lanesIndex[16];
+		_mm512_store_ps(lanesT, bestT);
+		_mm512_store_si512(lanesIndex, bestLane);
+		for (int lane = 0; lane < 16; ++lane)
+		{
+			if (lanesIndex[lane] >= 0 && lanesT[lane] < t_max)
+			{
+				t_max = lanesT[lane];
+				bestIndex = lanesIndex[lane];
+			}
+		}
+#elif SPHERE_SET_LANES == 8
+		const __m256 ox = _mm256_set1_ps(r.origin.x), oy = _mm256_set1_ps(r.origin.y), oz = _mm256_set1_ps(r.origin.z);
+		const __m256 dx = _mm256_set1_ps(r.direction.x), dy = _mm256_set1_ps(r.direction.y), dz = _mm256_set1_ps(r.direction.z);
+		const __m256 va = _mm256_set1_ps(a), invA = _mm256_set1_ps(1.0f / a), tMin = _mm256_set1_ps(t_min);
+		const __m256 zero = _mm256_setzero_ps();
+		__m256 bestT = _mm256_set1_ps(t_max);
+		__m256i bestLane = _mm256_set1_epi32(-1);
+		__m256i laneIndex = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(first)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		const __m256i endIndex = _mm256_set1_epi32(static_cast<int32_t>(end));
+
+		for (uint32_t i = first; i < end; i += 8)
+		{
+			const __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(&m_centerX[i]));
+			const __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(&m_centerY[i]));
+			const __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(&m_centerZ[i]));
+			const __m256 radius = _mm256_loadu_ps(&m_radius[i]);
+
+			const __m256 b = _mm256_fmadd_ps(ocx, dx, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocz, dz)));
+			const __m256 c = _mm256_fmsub_ps(ocx, ocx, _mm256_fnmadd_ps(ocy, ocy, _mm256_fnmadd_ps(ocz, ocz, _mm256_mul_ps(radius, radius))));
+			const __m256 discriminant = _mm256_fmsub_ps(b, b, _mm256_mul_ps(va, c));
+			const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GT_OQ), _mm256_castsi256_ps(_mm256_cmpgt_epi32(endIndex, laneIndex)));
+
+			const __m256 sqrtD = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+			const __m256 minusB = _mm256_sub_ps(zero, b);
+			const __m256 tNear = _mm256_mul_ps(_mm256_sub_ps(minusB, sqrtD), invA);
+			const __m256 tFar = _mm256_mul_ps(_mm256_add_ps(minusB, sqrtD), invA);
+			const __m256 t = _mm256_blendv_ps(tFar, tNear, _mm256_cmp_ps(tNear, tMin, _CMP_GT_OQ));
+
+			const __m256 hit = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, tMin, _CMP_GT_OQ), _mm256_cmp_ps(t, bestT, _CMP_LT_OQ)));
+			bestT = _mm256_blendv_ps(bestT, t, hit);
+			bestLane = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestLane), _mm256_castsi256_ps(laneIndex), hit));
+			laneIndex = _mm256_add_epi32(laneIndex, _mm256_set1_epi32(8));
+		}
+
+		alignas(32) float lanesT[8];
+		alignas(32) int32_t lanesIndex[8];
+		_mm256_store_ps(lanesT, bestT);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lanesIndex), bestLane);
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			if (lanesIndex[lane] >= 0 && lanesT[lane] < t_max)
+			{
+				t_max = lanesT[lane];
+				bestIndex = lanesIndex[lane];
+			}
+		}
+#else
+		for (uint32_t i = first; i < end; ++i)
+		{
+			const Vec3f oc = r.origin - Center(i);
+			const float b = dot(oc, r.direction);
+			const float c = dot(oc, oc) - m_radius[i] * m_radius[i];
+			const float discriminant = b * b - a * c;
+			if (discriminant > 0)
+			{
+				const float sqrtD = sqrtf(discriminant);
+				float t = (-b - sqrtD) / a;
+				if (t <= t_min)
+				{
+					t = (-b + sqrtD) / a;
+				}
+				if (t > t_min && t < t_max)
+				{
+					t_max = t;
+					bestIndex = static_cast<int32_t>(i);
+				}
+			}
+		}
+#endif
+		return bestIndex;
+	}
+
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_radius;
+	std::vector<MaterialID> m_materialIDs;
+	size_t m_count = 0;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint>
+#include <string>
+
+// Hot path counters. Every thread increments its own cache line aligned block with
+// plain adds, blocks are only summed by Collect() while no thread is tracing (at frame
+// end, after the pool's join), so there is no contention and no atomics. On in debug
+// builds, RT_STATS=1 keeps them in release builds, otherwise the macros expand to
+// nothing and their arguments are never evaluated
+#ifndef RT_STATS
+#ifdef NDEBUG
+#define RT_STATS 0
+#else
+#define RT_STATS 1
+#endif
+#endif
+
+namespace STATS
+{
+	enum Counter : uint32_t
+	{
+		PRIMARY_RAYS,
+		SECONDARY_RAYS,
+		PRIMITIVE_TESTS,    // ray/primitive intersection tests
+		BVH_NODES,          // nodes visited, leaves included
+		ESCAPED,            // paths that left the scene
+		ABSORBED,           // paths ended by Material::Scatter
+		DEPTH_LIMITED,      // paths cut at the maximum depth
+		ROULETTE_KILLS,     // paths ended by Russian roulette
+		SCATTER_LAMBERTIAN, // one per scattering MaterialType, in enum order
+		SCATTER_METALLIC,
+		SCATTER_DIELECTRIC,
+		REORDERED_RAYS,     // secondary rays sorted by the wavefront's reordering stage
+		REORDER_BINS,       // runs of sorted rays sharing a direction octant and a coarse origin cell
+		SHADOW_RAYS,        // light sampling occlusion rays
+		EMITTER_HITS,       // paths ended on an emissive surface
+		COUNTER_COUNT
+	};
+
+	inline constexpr const char* COUNTER_NAMES[COUNTER_COUNT] =
+	{
+		"primary_rays", "secondary_rays", "primitive_tests", "bvh_nodes", "escaped", "absorbed",
+		"depth_limited", "roulette_kills", "scatter_lambertian", "scatter_metallic", "scatter_dielectric",
+		"reordered_rays", "reorder_bins", "shadow_rays", "emitter_hits",
+	};
+
+	// bounces per path, the last bucket holds every longer path
+	static constexpr uint32_t PATH_LENGTH_BUCKETS = 17;
+
+	inline constexpr bool ENABLED = RT_STATS != 0;
+
+	struct Snapshot
+	{
+		uint64_t counters[COUNTER_COUNT] = {};
+		uint64_t pathLengths[PATH_LENGTH_BUCKETS] = {};
+
+		void RecordPath(uint32_t bounces) noexcept
+		{
+			++pathLengths[bounces < PATH_LENGTH_BUCKETS ? bounces : PATH_LENGTH_BUCKETS - 1];
+		}
+
+		Snapshot& operator+=(const Snapshot& other) noexcept
+		{
+			for (uint32_t i = 0; i < COUNTER_COUNT; ++i)
+			{
+				counters[i] += other.counters[i];
+			}
+			for (uint32_t i = 0; i < PATH_LENGTH_BUCKETS; ++i)
+			{
+				pathLengths[i] += other.pathLengths[i];
+			}
+			return *this;
+		}
+
+		Snapshot operator-(const Snapshot& other) const noexcept
+		{
+			Snapshot result = *this;
+			for (uint32_t i = 0; i < COUNTER_COUNT; ++i)
+			{
+				result.counters[i] -= other.counters[i];
+			}
+			for (uint32_t i = 0; i < PATH_LENGTH_BUCKETS; ++i)
+			{
+				result.pathLengths[i] -= other.pathLengths[i];
+			}
+			return result;
+		}
+
+		uint64_t Rays() const noexcept { return counters[PRIMARY_RAYS] + counters[SECONDARY_RAYS] + counters[SHADOW_RAYS]; }
+		uint64_t Paths() const noexcept;
+		double MeanBounces() const noexcept;
+
+		// one line summary of the ratios that matter for throughput
+		std::string Summary() const;
+		// counters, derived ratios and the path length histogram as a JSON object
+		std::string Json(const char* indent) const;
+	};
+
+	// the calling thread's block, registered on first use and kept for the process lifetime
+	Snapshot& RegisterThread();
+	inline thread_local Snapshot* t_local = nullptr;
+
+	inline Snapshot& Local()
+	{
+		return t_local ? *t_local : RegisterThread();
+	}
+
+	// sum over every thread that ever counted, call while none of them is counting
+	Snapshot Collect();
+};
+
+#if RT_STATS
+#define RT_STAT_ADD(counter, amount) (STATS::Local().counters[counter] += (amount))
+#define RT_STAT_PATH(bounces) (STATS::Local().RecordPath(static_cast<uint32_t>(bounces)))
+#else
+#define RT_STAT_ADD(counter, amount) ((void)0)
+#define RT_STAT_PATH(bounces) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Dedicated worker threads, each with its own task deque. ParallelFor splits the
+// index range into contiguous blocks, one per worker, workers drain their own deque
+// from the front and steal from the back of the others when they run dry
+class ThreadPool
+{
+public:
+	struct WorkerStats
+	{
+		uint64_t tasks = 0;
+		uint64_t steals = 0;
+		double busySeconds = 0.0;
+	};
+
+	// 0 uses every hardware thread
+	explicit ThreadPool(size_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Runs task(i) for every i in [0, count) and blocks until all of them finished.
+	// While profiling, every task is a span called spanName on its worker's track
+	template <typename Task>
+	void ParallelFor(size_t count, Task&& task, const char* spanName = "task")
+	{
+		m_spanName = spanName;
+		using TaskType = std::remove_reference_t<Task>;
+		m_taskContext = const_cast<void*>(static_cast<const void*>(&task));
+		m_taskInvoke = [](void* context, size_t index) noexcept
+			{
+				(*static_cast<TaskType*>(context))(index);
+			};
+		Dispatch(count);
+	}
+
+	size_t ThreadCount() const noexcept { return m_workers.size(); }
+
+	// Per worker counters since the last ResetStats, utilization is busy time over
+	// the wall time spent inside ParallelFor
+	WorkerStats Stats(size_t worker) const noexcept { return m_workers[worker]->stats; }
+	double Utilization(size_t worker) const noexcept;
+	double AverageUtilization() const noexcept;
+	std::string UtilizationReport() const;
+	void ResetStats() noexcept;
+
+private:
+	struct alignas(64) Worker
+	{
+		std::mutex mutex;
+		std::deque<size_t> tasks;
+		WorkerStats stats;
+		std::thread thread;
+
+		// the current dispatch, for the profiler's idle spans
+		uint64_t firstTaskBegin = 0;
+		uint64_t lastTaskEnd = 0;
+		uint64_t busyNanoseconds = 0;
+		uint32_t dispatchTasks = 0;
+		std::atomic<uint32_t> traceThread = UINT32_MAX;
+	};
+
+	void Dispatch(size_t count);
+	void RecordDispatch(size_t count, uint64_t begin, uint64_t end) const;
+	void WorkerLoop(size_t workerIndex);
+	bool PopLocal(size_t workerIndex, size_t& task) noexcept;
+	bool Steal(size_t thiefIndex, size_t& task) noexcept;
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint64_t m_generation = 0;
+	bool m_stop = false;
+	std::atomic<size_t> m_remaining = 0;
+
+	void* m_taskContext = nullptr;
+	void (*m_taskInvoke)(void*, size_t) noexcept = nullptr;
+	const char* m_spanName = "task";
+	double m_wallSeconds = 0.0;
+};
+
+#endif
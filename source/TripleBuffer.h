@@ -0,0 +1,47 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Single producer, single consumer handoff of whole frames. The writer and the reader
+// own one slot each and the third one sits in the middle, publishing and picking up
+// a frame are one atomic exchange each, so neither side ever waits for the other.
+// The reader always gets the newest published frame, older ones are dropped
+template <typename T>
+class TripleBuffer
+{
+public:
+	// only safe while no other thread uses the buffer, e.g. to size the slots
+	T& Slot(uint32_t index) noexcept { return m_slots[index]; }
+
+	T& WriteBuffer() noexcept { return m_slots[m_writeIndex]; }
+	const T& ReadBuffer() const noexcept { return m_slots[m_readIndex]; }
+
+	void Publish() noexcept
+	{
+		m_writeIndex = m_middle.exchange(m_writeIndex | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// swaps the newest published frame in, returns false if nothing new was published
+	bool Acquire() noexcept
+	{
+		if ((m_middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0)
+		{
+			return false;
+		}
+		m_readIndex = m_middle.exchange(m_readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+private:
+	static constexpr uint32_t FRESH_BIT = 4;
+	static constexpr uint32_t INDEX_MASK = 3;
+
+	T m_slots[3];
+	uint32_t m_writeIndex = 0;
+	uint32_t m_readIndex = 1;
+	std::atomic<uint32_t> m_middle = 2;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <utility>
+#include <vector>
+#include "Scene.h"
+
+enum class Integrator : uint8_t
+{
+	MEGAKERNEL, // RayColor, one path at a time through every bounce
+	WAVEFRONT,  // batches advanced one bounce at a time in stages, see Wavefront
+};
+
+inline const char* IntegratorName(Integrator integrator) noexcept
+{
+	return integrator == Integrator::WAVEFRONT ? "Wavefront" : "Megakernel";
+}
+
+// Wavefront path tracing. Instead of following each path through traversal and
+// every material branch in turn, a batch of paths advances one bounce at a time
+// in stages, each a tight loop over a queue: intersect every live ray sorting the
+// hits into one queue per MaterialType, shade the escaped paths against the
+// background and the emitters found, then run each material's scatter kernel over
+// its own homogeneous queue, and trace the shadow rays those kernels queued for
+// light sampling. Survivors form the next extension queue. Queues keep their capacity
+// across bounces and batches. Every path carries its own counter based Sampler and
+// adds its radiance terms in RayColor's order, so with floating point contraction
+// off (CMakeLists.txt) the image is the one RayColor computes, bit for bit. Under
+// /fp:fast it is equal up to float rounding. Optionally the secondary rays are
+// sorted before each intersect stage, see Reorder
+class Wavefront
+{
+public:
+	// starts a batch, paths are numbered in the order they are added
+	void Begin(size_t pathCount)
+	{
+		m_paths.clear();
+		m_paths.reserve(pathCount);
+	}
+
+	void AddPath(const Ray& ray, const Sampler& sampler)
+	{
+		m_paths.push_back({ ray, Vec3f(1.0f, 1.0f, 1.0f), Vec3f(0.0f, 0.0f, 0.0f), sampler, HitRegistry(), Vec3f(0.0f, 0.0f, 0.0f), 0.0f });
+	}
+
+	struct Settings
+	{
+		int maxDepth = 50;
+		int rouletteStartDepth = 3;
+		bool primaryPackets = false;   // intersect the camera rays as packets of consecutive paths
+		bool reorderSecondary = false; // sort every later extension queue by ray origin and direction
+		bool lightSampling = false;    // next event estimation at Lambertian vertices, as in RayColor
+	};
+
+	// traces every path of the batch to its end, returns the number of rays traced
+	uint64_t Trace(const Scene& scene, const Settings& settings) noexcept;
+
+	const Vec3f& Radiance(size_t path) const noexcept { return m_paths[path].radiance; }
+
+private:
+	struct Path
+	{
+		Ray ray;
+		Vec3f throughput;
+		Vec3f radiance;
+		Sampler sampler;
+		HitRegistry hit;
+		Vec3f lastPosition; // where the last BSDF ray left
+		float lastPdf;      // its density, 0 unless that vertex sampled lights
+	};
+
+	struct ShadowRay
+	{
+		Ray ray;
+		float distance;
+		Vec3f radiance; // added to the path when nothing blocks the ray
+		uint32_t path;
+	};
+
+	void Intersect(const Scene& scene, int depth, int maxDepth, bool packets) noexcept;
+	void IntersectPackets(const Scene& scene) noexcept;
+	void Reorder() noexcept;
+	void ShadeEscaped(const Scene& scene, int depth) noexcept;
+	void ShadeEmissive(const Scene& scene, int depth) noexcept;
+	template <MaterialType type>
+	void Shade(const Scene& scene, int depth, const Settings& settings) noexcept;
+	void TraceShadows(const Scene& scene) noexcept;
+
+	std::vector<Path> m_paths;
+	std::vector<uint32_t> m_extension;     // paths whose next ray is traced this bounce
+	std::vector<uint32_t> m_nextExtension; // survivors of this bounce
+	std::vector<uint32_t> m_escaped;       // rays that left the scene this bounce
+	std::vector<uint32_t> m_materialQueues[MATERIAL_TYPE_COUNT];
+	std::vector<ShadowRay> m_shadowRays;   // light samples of this bounce
+	std::vector<std::pair<uint64_t, uint32_t>> m_sortKeys; // (ray key, path), see Reorder
+};
+
+#endif
@@ -0,0 +1,365 @@
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include <immintrin.h>
+#include <bit>
+#include "BVH.h"
+
+// SoA slab test helpers, one lane per child box
+template <uint32_t WIDTH>
+struct SimdLanes;
+
+template <>
+struct SimdLanes<4>
+{
+	using Float = __m128;
+
+	static Float Load(const float* p) noexcept { return _mm_load_ps(p); }
+	static Float Set1(float v) noexcept { return _mm_set1_ps(v); }
+	static Float Sub(Float a, Float b) noexcept { return _mm_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) noexcept { return _mm_mul_ps(a, b); }
+	static Float Min(Float a, Float b) noexcept { return _mm_min_ps(a, b); }
+	static Float Max(Float a, Float b) noexcept { return _mm_max_ps(a, b); }
+	static uint32_t LessEqual(Float a, Float b) noexcept { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(a, b))); }
+	static void Store(float* p, Float v) noexcept { _mm_store_ps(p, v); }
+};
+
+#ifdef __AVX__
+template <>
+struct SimdLanes<8>
+{
+	using Float = __m256;
+
+	static Float Load(const float* p) noexcept { return _mm256_load_ps(p); }
+	static Float Set1(float v) noexcept { return _mm256_set1_ps(v); }
+	static Float Sub(Float a, Float b) noexcept { return _mm256_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) noexcept { return _mm256_mul_ps(a, b); }
+	static Float Min(Float a, Float b) noexcept { return _mm256_min_ps(a, b); }
+	static Float Max(Float a, Float b) noexcept { return _mm256_max_ps(a, b); }
+	static uint32_t LessEqual(Float a, Float b) noexcept { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ))); }
+	static void Store(float* p, Float v) noexcept { _mm256_store_ps(p, v); }
+};
+#define WIDE_BVH_HAS_8 1
+#endif
+
+// N-ary BVH collapsed from the binary SAH tree. Child boxes are stored as SoA slabs so
+// a ray tests every child of a node with one vector slab test and visits the hits
+// front to back. Leaves keep the (first, count) ranges of the binary tree, so the
+// same leaf functor and BVH::PrimitiveIndices() are used for both
+template <uint32_t WIDTH>
+class WideBVH
+{
+public:
+	struct alignas(32) Node
+	{
+		float minX[WIDTH], minY[WIDTH], minZ[WIDTH];
+		float maxX[WIDTH], maxY[WIDTH], maxZ[WIDTH];
+		uint32_t child[WIDTH]; // wide node index for interior children, first primitive index for leaves
+		uint32_t count[WIDTH]; // 0 for interior children
+		uint32_t childCount;   // valid lanes, packed from lane 0
+	};
+
+	void Build(const BVH& bvh)
+	{
+		m_nodes.clear();
+		const std::vector<BVH::Node>& binaryNodes = bvh.Nodes();
+		if (binaryNodes.empty())
+		{
+			return;
+		}
+		m_nodes.reserve(binaryNodes.size() / 2 + 1);
+		Collapse(binaryNodes, 0);
+	}
+
+	template <typename LeafFunc>
+	bool Traverse(const Ray& r, float t_min, float t_max, LeafFunc&& intersectLeaf) const noexcept
+	{
+		using Lanes = SimdLanes<WIDTH>;
+
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		const Vec3f invDir = SafeInverse(r.direction);
+		const typename Lanes::Float ox = Lanes::Set1(r.origin.x), oy = Lanes::Set1(r.origin.y), oz = Lanes::Set1(r.origin.z);
+		const typename Lanes::Float ix = Lanes::Set1(invDir.x), iy = Lanes::Set1(invDir.y), iz = Lanes::Set1(invDir.z);
+		const typename Lanes::Float tMinLanes = Lanes::Set1(t_min);
+
+		struct StackEntry { uint32_t child; uint32_t count; float tNear; };
+		StackEntry stack[BVH::MAX_DEPTH * WIDTH];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0, t_min };
+
+		bool hitAnything = false;
+		alignas(32) float tNear[WIDTH];
+
+		while (stackSize > 0)
+		{
+			const StackEntry entry = stack[--stackSize];
+			if (entry.tNear > t_max)
+			{
+				continue;
+			}
+			RT_STAT_ADD(STATS::BVH_NODES, 1);
+			if (entry.count > 0)
+			{
+				hitAnything |= intersectLeaf(entry.child, entry.count, t_max);
+				continue;
+			}
+
+			const Node& node = m_nodes[entry.child];
+			const typename Lanes::Float tx1 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.minX), ox), ix);
+			const typename Lanes::Float tx2 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.maxX), ox), ix);
+			const typename Lanes::Float ty1 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.minY), oy), iy);
+			const typename Lanes::Float ty2 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.maxY), oy), iy);
+			const typename Lanes::Float tz1 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.minZ), oz), iz);
+			const typename Lanes::Float tz2 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.maxZ), oz), iz);
+
+			const typename Lanes::Float entryT = Lanes::Max(Lanes::Max(Lanes::Min(tx1, tx2), Lanes::Min(ty1, ty2)), Lanes::Max(Lanes::Min(tz1, tz2), tMinLanes));
+			const typename Lanes::Float exitT = Lanes::Min(Lanes::Min(Lanes::Max(tx1, tx2), Lanes::Max(ty1, ty2)), Lanes::Min(Lanes::Max(tz1, tz2), Lanes::Set1(t_max)));
+
+			uint32_t hitMask = Lanes::LessEqual(entryT, exitT) & ((1u << node.childCount) - 1u);
+			if (hitMask == 0)
+			{
+				continue;
+			}
+			Lanes::Store(tNear, entryT);
+
+			// order the hit lanes far to near so the nearest child ends up on top of the stack
+			uint32_t order[WIDTH];
+			uint32_t hitCount = 0;
+			while (hitMask)
+			{
+				const uint32_t lane = static_cast<uint32_t>(std::countr_zero(hitMask));
+				hitMask &= hitMask - 1;
+
+				uint32_t slot = hitCount++;
+				while (slot > 0 && tNear[order[slot - 1]] < tNear[lane])
+				{
+					order[slot] = order[slot - 1];
+					--slot;
+				}
+				order[slot] = lane;
+			}
+			for (uint32_t i = 0; i < hitCount; ++i)
+			{
+				const uint32_t lane = order[i];
+				stack[stackSize++] = { node.child[lane], node.count[lane], tNear[lane] };
+			}
+		}
+
+		return hitAnything;
+	}
+
+	// Any-hit version of Traverse, see BVH::TraverseAny. The hit children are pushed
+	// in lane order, without the front to back sort
+	template <typename OccludedLeafFunc>
+	bool TraverseAny(const Ray& r, float t_min, float t_max, OccludedLeafFunc&& occludedLeaf) const noexcept
+	{
+		using Lanes = SimdLanes<WIDTH>;
+
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		const Vec3f invDir = SafeInverse(r.direction);
+		const typename Lanes::Float ox = Lanes::Set1(r.origin.x), oy = Lanes::Set1(r.origin.y), oz = Lanes::Set1(r.origin.z);
+		const typename Lanes::Float ix = Lanes::Set1(invDir.x), iy = Lanes::Set1(invDir.y), iz = Lanes::Set1(invDir.z);
+		const typename Lanes::Float tMinLanes = Lanes::Set1(t_min), tMaxLanes = Lanes::Set1(t_max);
+
+		struct StackEntry { uint32_t child; uint32_t count; };
+		StackEntry stack[BVH::MAX_DEPTH * WIDTH];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0 };
+
+		while (stackSize > 0)
+		{
+			const StackEntry entry = stack[--stackSize];
+			RT_STAT_ADD(STATS::BVH_NODES, 1);
+			if (entry.count > 0)
+			{
+				if (occludedLeaf(entry.child, entry.count))
+				{
+					return true;
+				}
+				continue;
+			}
+
+			const Node& node = m_nodes[entry.child];
+			const typename Lanes::Float tx1 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.minX), ox), ix);
+			const typename Lanes::Float tx2 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.maxX), ox), ix);
+			const typename Lanes::Float ty1 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.minY), oy), iy);
+			const typename Lanes::Float ty2 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.maxY), oy), iy);
+			const typename Lanes::Float tz1 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.minZ), oz), iz);
+			const typename Lanes::Float tz2 = Lanes::Mul(Lanes::Sub(Lanes::Load(node.maxZ), oz), iz);
+
+			const typename Lanes::Float entryT = Lanes::Max(Lanes::Max(Lanes::Min(tx1, tx2), Lanes::Min(ty1, ty2)), Lanes::Max(Lanes::Min(tz1, tz2), tMinLanes));
+			const typename Lanes::Float exitT = Lanes::Min(Lanes::Min(Lanes::Max(tx1, tx2), Lanes::Max(ty1, ty2)), Lanes::Min(Lanes::Max(tz1, tz2), tMaxLanes));
+
+			uint32_t hitMask = Lanes::LessEqual(entryT, exitT) & ((1u << node.childCount) - 1u);
+			while (hitMask)
+			{
+				const uint32_t lane = static_cast<uint32_t>(std::countr_zero(hitMask));
+				hitMask &= hitMask - 1;
+				stack[stackSize++] = { node.child[lane], node.count[lane] };
+			}
+		}
+
+		return false;
+	}
+
+#if RAY_PACKETS
+	// Packet version of Traverse, see BVH::TraversePacket. Children are tested one at
+	// a time against the whole packet and pushed with the lanes that hit them
+	template <typename PacketLeafFunc>
+	void TraversePacket(RayPacket& packet, float t_min, PacketLeafFunc&& intersectLeaf) const noexcept
+	{
+		if (m_nodes.empty())
+		{
+			return;
+		}
+
+		struct StackEntry { uint32_t child; uint32_t count; float tNear; uint32_t laneMask; };
+		StackEntry stack[BVH::MAX_DEPTH * WIDTH];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0, t_min, packet.activeMask };
+
+		float farthest = packet.FarthestHit();
+		float tNear[WIDTH];
+		uint32_t laneMasks[WIDTH];
+
+		while (stackSize > 0)
+		{
+			const StackEntry entry = stack[--stackSize];
+			if (entry.tNear > farthest)
+			{
+				continue;
+			}
+			RT_STAT_ADD(STATS::BVH_NODES, 1);
+			if (entry.count > 0)
+			{
+				intersectLeaf(entry.child, entry.count, entry.laneMask);
+				farthest = packet.FarthestHit();
+				continue;
+			}
+
+			const Node& node = m_nodes[entry.child];
+			uint32_t order[WIDTH];
+			uint32_t hitCount = 0;
+			for (uint32_t lane = 0; lane < node.childCount; ++lane)
+			{
+				const AABB box(Vec3f(node.minX[lane], node.minY[lane], node.minZ[lane]), Vec3f(node.maxX[lane], node.maxY[lane], node.maxZ[lane]));
+				if (!(laneMasks[lane] = packet.Intersect(box, t_min, tNear[lane])))
+				{
+					continue;
+				}
+
+				// far to near, the nearest child ends up on top of the stack
+				uint32_t slot = hitCount++;
+				while (slot > 0 && tNear[order[slot - 1]] < tNear[lane])
+				{
+					order[slot] = order[slot - 1];
+					--slot;
+				}
+				order[slot] = lane;
+			}
+			for (uint32_t i = 0; i < hitCount; ++i)
+			{
+				const uint32_t lane = order[i];
+				stack[stackSize++] = { node.child[lane], node.count[lane], tNear[lane], laneMasks[lane] };
+			}
+		}
+	}
+#endif
+
+	bool Empty() const noexcept { return m_nodes.empty(); }
+	const std::vector<Node>& Nodes() const noexcept { return m_nodes; }
+
+private:
+	uint32_t Collapse(const std::vector<BVH::Node>& binaryNodes, uint32_t binaryIndex)
+	{
+		const uint32_t wideIndex = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.emplace_back();
+
+		// open the interior child with the largest area until the node is full
+		uint32_t children[WIDTH];
+		uint32_t childCount = 0;
+		if (binaryNodes[binaryIndex].IsLeaf())
+		{
+			children[childCount++] = binaryIndex;
+		}
+		else
+		{
+			children[childCount++] = binaryNodes[binaryIndex].leftFirst;
+			children[childCount++] = binaryNodes[binaryIndex].leftFirst + 1;
+		}
+
+		while (childCount < WIDTH)
+		{
+			int largest = -1;
+			float largestArea = -1.0f;
+			for (uint32_t i = 0; i < childCount; ++i)
+			{
+				const BVH::Node& candidate = binaryNodes[children[i]];
+				if (!candidate.IsLeaf() && candidate.bounds.HalfArea() > largestArea)
+				{
+					largestArea = candidate.bounds.HalfArea();
+					largest = static_cast<int>(i);
+				}
+			}
+			if (largest < 0)
+			{
+				break;
+			}
+			const uint32_t opened = binaryNodes[children[largest]].leftFirst;
+			children[largest] = opened;
+			children[childCount++] = opened + 1;
+		}
+
+		for (uint32_t lane = 0; lane < WIDTH; ++lane)
+		{
+			Node& node = m_nodes[wideIndex];
+			if (lane >= childCount)
+			{
+				node.minX[lane] = node.minY[lane] = node.minZ[lane] = 0.0f;
+				node.maxX[lane] = node.maxY[lane] = node.maxZ[lane] = 0.0f;
+				node.child[lane] = 0;
+				node.count[lane] = 0;
+				continue;
+			}
+
+			const BVH::Node& binaryChild = binaryNodes[children[lane]];
+			node.minX[lane] = binaryChild.bounds.min.x;
+			node.minY[lane] = binaryChild.bounds.min.y;
+			node.minZ[lane] = binaryChild.bounds.min.z;
+			node.maxX[lane] = binaryChild.bounds.max.x;
+			node.maxY[lane] = binaryChild.bounds.max.y;
+			node.maxZ[lane] = binaryChild.bounds.max.z;
+			node.count[lane] = binaryChild.count;
+			node.child[lane] = binaryChild.leftFirst;
+		}
+		m_nodes[wideIndex].childCount = childCount;
+
+		// recursion may reallocate m_nodes, so interior children are patched by index afterwards
+		for (uint32_t lane = 0; lane < childCount; ++lane)
+		{
+			if (!binaryNodes[children[lane]].IsLeaf())
+			{
+				const uint32_t childIndex = Collapse(binaryNodes, children[lane]);
+				m_nodes[wideIndex].child[lane] = childIndex;
+			}
+		}
+		return wideIndex;
+	}
+
+	std::vector<Node> m_nodes;
+};
+
+using BVH4 = WideBVH<4>;
+#ifdef WIDE_BVH_HAS_8
+using BVH8 = WideBVH<8>;
+#endif
+
+#endif
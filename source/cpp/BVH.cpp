@@ -0,0 +1,177 @@
+#include <algorithm>
+#include "../BVH.h"
+
+void BVH::Build(const std::vector<AABB>& primitiveBounds)
+{
+	m_nodes.clear();
+	m_primitiveIndices.clear();
+
+	const uint32_t primitiveCount = static_cast<uint32_t>(primitiveBounds.size());
+	if (primitiveCount == 0)
+	{
+		return;
+	}
+
+	std::vector<Vec3f> centroids(primitiveCount);
+	m_primitiveIndices.resize(primitiveCount);
+	for (uint32_t i = 0; i < primitiveCount; ++i)
+	{
+		centroids[i] = primitiveBounds[i].Centroid();
+		m_primitiveIndices[i] = i;
+	}
+
+	// a binary tree with N leaves at most has 2N - 1 nodes
+	m_nodes.reserve(2 * static_cast<size_t>(primitiveCount) - 1);
+	m_nodes.emplace_back();
+	m_nodes[0].leftFirst = 0;
+	m_nodes[0].count = primitiveCount;
+	UpdateBounds(m_nodes[0], primitiveBounds);
+
+	Subdivide(0, 0, primitiveBounds, centroids);
+	m_nodes.shrink_to_fit();
+}
+
+void BVH::UpdateBounds(Node& node, const std::vector<AABB>& primitiveBounds) const noexcept
+{
+	node.bounds = AABB();
+	for (uint32_t i = 0; i < node.count; ++i)
+	{
+		node.bounds.Grow(primitiveBounds[m_primitiveIndices[node.leftFirst + i]]);
+	}
+}
+
+float BVH::FindBestSplit(const Node& node, const std::vector<AABB>& primitiveBounds, const std::vector<Vec3f>& centroids, int& bestAxis, float& bestSplit) const noexcept
+{
+	struct Bin
+	{
+		AABB bounds;
+		uint32_t count = 0;
+	};
+
+	AABB centroidBounds;
+	for (uint32_t i = 0; i < node.count; ++i)
+	{
+		centroidBounds.Grow(centroids[m_primitiveIndices[node.leftFirst + i]]);
+	}
+
+	float bestCost = FLT_MAX;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float boundsMin = centroidBounds.min[axis];
+		const float boundsMax = centroidBounds.max[axis];
+		if (boundsMin == boundsMax)
+		{
+			continue;
+		}
+
+		Bin bins[SAH_BINS];
+		const float scale = SAH_BINS / (boundsMax - boundsMin);
+		for (uint32_t i = 0; i < node.count; ++i)
+		{
+			const uint32_t primitive = m_primitiveIndices[node.leftFirst + i];
+			const uint32_t binIndex = std::min(SAH_BINS - 1, static_cast<uint32_t>((centroids[primitive][axis] - boundsMin) * scale));
+			bins[binIndex].count++;
+			bins[binIndex].bounds.Grow(primitiveBounds[primitive]);
+		}
+
+		// sweep from both sides to get the area and count of every candidate plane
+		float leftArea[SAH_BINS - 1], rightArea[SAH_BINS - 1];
+		uint32_t leftCount[SAH_BINS - 1], rightCount[SAH_BINS - 1];
+		AABB leftBox, rightBox;
+		uint32_t leftSum = 0, rightSum = 0;
+		for (uint32_t i = 0; i < SAH_BINS - 1; ++i)
+		{
+			leftSum += bins[i].count;
+			leftCount[i] = leftSum;
+			leftBox.Grow(bins[i].bounds);
+			leftArea[i] = leftBox.HalfArea();
+
+			rightSum += bins[SAH_BINS - 1 - i].count;
+			rightCount[SAH_BINS - 2 - i] = rightSum;
+			rightBox.Grow(bins[SAH_BINS - 1 - i].bounds);
+			rightArea[SAH_BINS - 2 - i] = rightBox.HalfArea();
+		}
+
+		const float binWidth = (boundsMax - boundsMin) / SAH_BINS;
+		for (uint32_t i = 0; i < SAH_BINS - 1; ++i)
+		{
+			if (leftCount[i] == 0 || rightCount[i] == 0)
+			{
+				continue;
+			}
+			const float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = boundsMin + binWidth * (i + 1);
+			}
+		}
+	}
+	return bestCost;
+}
+
+void BVH::Subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& primitiveBounds, const std::vector<Vec3f>& centroids)
+{
+	Node& node = m_nodes[nodeIndex];
+	if (node.count <= 1 || depth >= MAX_DEPTH - 1)
+	{
+		return;
+	}
+
+	int axis = 0;
+	float splitPosition = 0.0f;
+	const float splitCost = FindBestSplit(node, primitiveBounds, centroids, axis, splitPosition);
+
+	// traversal cost is taken as one primitive test, costs are relative to the parent area
+	const float parentArea = node.bounds.HalfArea();
+	const float leafCost = static_cast<float>(node.count);
+	if (splitCost == FLT_MAX || (parentArea > 0.0f && 1.0f + splitCost / parentArea >= leafCost && node.count <= MAX_LEAF_SIZE))
+	{
+		return;
+	}
+
+	uint32_t i = node.leftFirst;
+	uint32_t j = i + node.count - 1;
+	while (i <= j)
+	{
+		if (centroids[m_primitiveIndices[i]][axis] < splitPosition)
+		{
+			++i;
+		}
+		else
+		{
+			std::swap(m_primitiveIndices[i], m_primitiveIndices[j]);
+			if (j == 0)
+			{
+				break;
+			}
+			--j;
+		}
+	}
+
+	const uint32_t leftCount = i - node.leftFirst;
+	if (leftCount == 0 || leftCount == node.count)
+	{
+		return;
+	}
+
+	const uint32_t leftChild = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.emplace_back();
+	m_nodes.emplace_back();
+
+	// emplace_back may not reallocate thanks to reserve, but don't rely on the old reference
+	Node& parent = m_nodes[nodeIndex];
+	m_nodes[leftChild].leftFirst = parent.leftFirst;
+	m_nodes[leftChild].count = leftCount;
+	m_nodes[leftChild + 1].leftFirst = i;
+	m_nodes[leftChild + 1].count = parent.count - leftCount;
+	parent.leftFirst = leftChild;
+	parent.count = 0;
+
+	UpdateBounds(m_nodes[leftChild], primitiveBounds);
+	UpdateBounds(m_nodes[leftChild + 1], primitiveBounds);
+
+	Subdivide(leftChild, depth + 1, primitiveBounds, centroids);
+	Subdivide(leftChild + 1, depth + 1, primitiveBounds, centroids);
+}
@@ -0,0 +1,367 @@
+#include "../Raytracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Throughput benchmark: renders a fixed set of seeded scenes for a fixed number of
+// samples through the production tile scheduler and reports Mrays/s, Msamples/s and
+// the distribution of frame times as JSON, so builds and machines can be compared.
+// Scene generation is portable (see RANDOM::SeedScene), the hash in the report
+// (SampleIdentity()) confirms two runs rendered the same scene with the same settings
+// and the image hash that they produced the same pixels. --check-packets renders every
+// scene a second time with packet tracing flipped and fails unless the images match
+
+namespace
+{
+	struct BenchmarkScene
+	{
+		const char* name;
+		uint32_t seed;
+		uint32_t gridScale;
+		uint32_t lights;
+	};
+
+	constexpr BenchmarkScene SCENES[] =
+	{
+		{ "weekend", 0, 1, 0 },     // the viewer's scene
+		{ "weekend-4x", 1, 2, 0 },
+		{ "weekend-16x", 2, 4, 0 },
+		{ "weekend-64x", 3, 8, 0 },
+		{ "weekend-lit", 0, 1, 8 }, // night sky, lit by small emissive spheres
+	};
+
+	struct SceneResult
+	{
+		const BenchmarkScene* scene;
+		uint64_t hash;
+		uint64_t imageHash;
+		bool packetsChecked;
+		bool packetsIdentical;
+		const char* accel;
+		size_t spheres;
+		size_t threads;
+		double buildMs;
+		size_t frames;
+		double seconds;
+		uint64_t rays;
+		uint64_t paths;
+		std::vector<double> frameMs; // sorted
+		STATS::Snapshot counters;
+	};
+
+	// nearest rank
+	double Percentile(const std::vector<double>& sorted, double p) noexcept
+	{
+		if (sorted.empty())
+		{
+			return 0.0;
+		}
+		const size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size()) + 0.999999);
+		return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+	}
+
+	const char* CompilerName() noexcept
+	{
+#if defined(__clang__)
+		return "clang " __clang_version__;
+#elif defined(__GNUC__)
+		return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+		return "msvc";
+#else
+		return "unknown";
+#endif
+	}
+
+	const char* InstructionSet() noexcept
+	{
+#if defined(__AVX512F__)
+		return "avx512";
+#elif defined(__AVX2__)
+		return "avx2";
+#elif defined(__AVX__)
+		return "avx";
+#else
+		return "sse";
+#endif
+	}
+};
+
+static void PrintUsage(const char* program)
+{
+	printf("usage: %s [options]\n"
+		"  --width N         image width (640)\n"
+		"  --height N        image height (384)\n"
+		"  --samples N       measured samples per pixel, one per frame (16)\n"
+		"  --warmup N        frames rendered before measuring (2)\n"
+		"  --threads N       worker threads, 0 for every hardware thread (0)\n"
+		"  --tile N          tile size in pixels (16)\n"
+		"  --sampler NAME    independent | sobol | rank1 (sobol)\n"
+		"  --accel NAME      linear | bvh2 | bvh4 | bvh8 (bvh8)\n"
+		"  --integrator NAME megakernel | wavefront (megakernel)\n"
+		"  --packets on|off  trace camera rays in 8 ray packets, needs AVX2 (off)\n"
+		"  --reorder on|off  sort wavefront secondary rays by origin and direction (off)\n"
+		"  --nee on|off      sample emissive spheres at diffuse vertices, MIS with BSDF sampling (on)\n"
+		"  --scene NAME      run only this scene, repeatable (all)\n"
+		"  --output PATH     write the JSON report to PATH instead of stdout\n"
+		"  --quiet           no progress output on stderr\n"
+		"  --check-packets   also render every scene with --packets flipped, fail unless the images are identical\n"
+		"scenes:", program);
+	for (const BenchmarkScene& scene : SCENES)
+	{
+		printf(" %s", scene.name);
+	}
+	printf("\n");
+}
+
+static SceneResult RunScene(const BenchmarkScene& scene, uint16_t width, uint16_t height, uint32_t samples, uint32_t warmup, size_t threads, size_t tileSize,
+	SamplerType sampler, AccelerationStructure accel, Integrator integrator, bool packets, bool reorder, bool lightSampling)
+{
+	RaytracingInAWeekend raytracer;
+	raytracer.SetThreadCount(threads);
+	raytracer.SetTileSize(tileSize);
+	raytracer.SetSampler(sampler);
+	raytracer.SetAccelerationStructure(accel);
+	raytracer.SetIntegrator(integrator);
+	raytracer.SetPacketTracing(packets);
+	raytracer.SetRayReordering(reorder);
+	raytracer.SetLightSampling(lightSampling);
+	raytracer.SetAdaptiveSampling(0.0f); // every frame traces every pixel
+	raytracer.SetRenderBudget(warmup + samples, 0.0f);
+
+	const auto buildStart = std::chrono::steady_clock::now();
+	raytracer.LoadScene(scene.seed, scene.gridScale, scene.lights);
+	const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+	raytracer.Start(std::make_unique<Platform::HeadlessBackend>(), width, height);
+
+	SceneResult result = {};
+	result.scene = &scene;
+	result.hash = raytracer.SampleIdentity();
+	result.imageHash = raytracer.ImageHash();
+	result.accel = raytracer.AccelerationStructureName();
+	result.spheres = raytracer.SphereCount();
+	result.threads = raytracer.GetThreadPool().ThreadCount();
+	result.buildMs = buildMs;
+
+	const std::vector<RaytracingInAWeekend::FrameStats>& history = raytracer.FrameHistory();
+	for (size_t frame = std::min<size_t>(warmup, history.size()); frame < history.size(); ++frame)
+	{
+		result.seconds += history[frame].seconds;
+		result.rays += history[frame].rays;
+		result.paths += history[frame].paths;
+		result.frameMs.push_back(history[frame].seconds * 1000.0);
+		result.counters += history[frame].counters;
+	}
+	result.frames = result.frameMs.size();
+	std::sort(result.frameMs.begin(), result.frameMs.end());
+	return result;
+}
+
+static void WriteReport(FILE* out, const std::vector<SceneResult>& results, uint16_t width, uint16_t height, uint32_t samples, uint32_t warmup, size_t threads,
+	size_t tileSize, SamplerType sampler, Integrator integrator, bool packets, bool reorder, bool lightSampling)
+{
+	// every scene is built with the same structure, the requested one or its fallback
+	const char* accelName = results.empty() ? "none" : results.front().accel;
+	fprintf(out, "{\n");
+	fprintf(out, "  \"build\": { \"compiler\": \"%s\", \"isa\": \"%s\", \"threads\": %zu },\n", CompilerName(), InstructionSet(), threads);
+	fprintf(out, "  \"settings\": { \"width\": %u, \"height\": %u, \"samples\": %u, \"warmup\": %u, \"tile\": %zu, \"sampler\": \"%s\", \"accel\": \"%s\", \"integrator\": \"%s\", \"packets\": %s, \"reorder\": %s, \"nee\": %s },\n",
+		width, height, samples, warmup, tileSize, SamplerName(sampler), accelName, IntegratorName(integrator), packets && RAY_PACKETS ? "true" : "false",
+		reorder && integrator == Integrator::WAVEFRONT ? "true" : "false", lightSampling ? "true" : "false");
+	fprintf(out, "  \"scenes\": [\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const SceneResult& r = results[i];
+		const double seconds = std::max(r.seconds, 1e-9);
+		double meanMs = 0.0;
+		for (double ms : r.frameMs)
+		{
+			meanMs += ms;
+		}
+		meanMs /= static_cast<double>(std::max<size_t>(r.frameMs.size(), 1));
+
+		fprintf(out, "    {\n");
+		fprintf(out, "      \"name\": \"%s\", \"seed\": %u, \"grid_scale\": %u, \"lights\": %u, \"hash\": \"%016llx\", \"image\": \"%016llx\", \"spheres\": %zu,\n",
+			r.scene->name, r.scene->seed, r.scene->gridScale, r.scene->lights, static_cast<unsigned long long>(r.hash), static_cast<unsigned long long>(r.imageHash), r.spheres);
+		if (r.packetsChecked)
+		{
+			fprintf(out, "      \"packets_identical\": %s,\n", r.packetsIdentical ? "true" : "false");
+		}
+		fprintf(out, "      \"build_ms\": %.3f, \"frames\": %zu, \"seconds\": %.6f, \"rays\": %llu, \"paths\": %llu,\n",
+			r.buildMs, r.frames, r.seconds, static_cast<unsigned long long>(r.rays), static_cast<unsigned long long>(r.paths));
+		fprintf(out, "      \"mrays_per_s\": %.4f, \"msamples_per_s\": %.4f, \"rays_per_sample\": %.4f,\n",
+			static_cast<double>(r.rays) / seconds * 1e-6, static_cast<double>(r.paths) / seconds * 1e-6, static_cast<double>(r.rays) / static_cast<double>(std::max<uint64_t>(r.paths, 1)));
+		fprintf(out, "      \"frame_ms\": { \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+			meanMs, Percentile(r.frameMs, 0.0), Percentile(r.frameMs, 50.0), Percentile(r.frameMs, 90.0), Percentile(r.frameMs, 95.0), Percentile(r.frameMs, 99.0), Percentile(r.frameMs, 100.0), STATS::ENABLED ? "," : "");
+		if constexpr (STATS::ENABLED)
+		{
+			fprintf(out, "      \"counters\": %s\n", r.counters.Json("      ").c_str());
+		}
+		fprintf(out, "    }%s\n", i + 1 < results.size() ? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint16_t width = 640;
+	uint16_t height = 384;
+	uint32_t samples = 16;
+	uint32_t warmup = 2;
+	size_t threads = 0;
+	size_t tileSize = 16;
+	SamplerType sampler = SamplerType::SOBOL;
+	AccelerationStructure accel = AccelerationStructure::BVH8;
+	Integrator integrator = Integrator::MEGAKERNEL;
+	bool packets = false;
+	bool reorder = false;
+	bool lightSampling = true;
+	std::vector<const BenchmarkScene*> selected;
+	const char* output = nullptr;
+	bool quiet = false;
+	bool checkPackets = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* option = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		const auto takesValue = [&]() -> bool
+			{
+				if (!value)
+				{
+					fprintf(stderr, "missing value for %s\n", option);
+					exit(EXIT_FAILURE);
+				}
+				++i;
+				return true;
+			};
+
+		if (!strcmp(option, "--width") && takesValue()) width = static_cast<uint16_t>(atoi(value));
+		else if (!strcmp(option, "--height") && takesValue()) height = static_cast<uint16_t>(atoi(value));
+		else if (!strcmp(option, "--samples") && takesValue()) samples = static_cast<uint32_t>(atoi(value));
+		else if (!strcmp(option, "--warmup") && takesValue()) warmup = static_cast<uint32_t>(atoi(value));
+		else if (!strcmp(option, "--threads") && takesValue()) threads = static_cast<size_t>(atoi(value));
+		else if (!strcmp(option, "--tile") && takesValue()) tileSize = static_cast<size_t>(atoi(value));
+		else if (!strcmp(option, "--output") && takesValue()) output = value;
+		else if (!strcmp(option, "--quiet")) quiet = true;
+		else if (!strcmp(option, "--check-packets")) checkPackets = true;
+		else if (!strcmp(option, "--scene") && takesValue())
+		{
+			const auto found = std::find_if(std::begin(SCENES), std::end(SCENES), [value](const BenchmarkScene& scene) { return !strcmp(scene.name, value); });
+			if (found == std::end(SCENES))
+			{
+				fprintf(stderr, "unknown scene %s\n", value);
+				return EXIT_FAILURE;
+			}
+			selected.push_back(&*found);
+		}
+		else if (!strcmp(option, "--sampler") && takesValue())
+		{
+			if (!strcmp(value, "independent")) sampler = SamplerType::INDEPENDENT;
+			else if (!strcmp(value, "sobol")) sampler = SamplerType::SOBOL;
+			else if (!strcmp(value, "rank1")) sampler = SamplerType::RANK1_BLUE_NOISE;
+			else { fprintf(stderr, "unknown sampler %s\n", value); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--integrator") && takesValue())
+		{
+			if (!strcmp(value, "megakernel")) integrator = Integrator::MEGAKERNEL;
+			else if (!strcmp(value, "wavefront")) integrator = Integrator::WAVEFRONT;
+			else { fprintf(stderr, "unknown integrator %s\n", value); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--packets") && takesValue())
+		{
+			if (!strcmp(value, "on")) packets = true;
+			else if (!strcmp(value, "off")) packets = false;
+			else { fprintf(stderr, "--packets expects on or off\n"); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--reorder") && takesValue())
+		{
+			if (!strcmp(value, "on")) reorder = true;
+			else if (!strcmp(value, "off")) reorder = false;
+			else { fprintf(stderr, "--reorder expects on or off\n"); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--nee") && takesValue())
+		{
+			if (!strcmp(value, "on")) lightSampling = true;
+			else if (!strcmp(value, "off")) lightSampling = false;
+			else { fprintf(stderr, "--nee expects on or off\n"); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--accel") && takesValue())
+		{
+			if (!strcmp(value, "linear")) accel = AccelerationStructure::LINEAR;
+			else if (!strcmp(value, "bvh2")) accel = AccelerationStructure::BVH2;
+			else if (!strcmp(value, "bvh4")) accel = AccelerationStructure::BVH4;
+			else if (!strcmp(value, "bvh8")) accel = AccelerationStructure::BVH8;
+			else { fprintf(stderr, "unknown acceleration structure %s\n", value); return EXIT_FAILURE; }
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return !strcmp(option, "--help") ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (width < 2 || height < 2 || samples == 0)
+	{
+		fprintf(stderr, "need a resolution of at least 2x2 and at least one sample\n");
+		return EXIT_FAILURE;
+	}
+	if (selected.empty())
+	{
+		for (const BenchmarkScene& scene : SCENES)
+		{
+			selected.push_back(&scene);
+		}
+	}
+
+	std::vector<SceneResult> results;
+	size_t threadCount = 0;
+	size_t mismatches = 0;
+	for (const BenchmarkScene* scene : selected)
+	{
+		if (!quiet)
+		{
+			fprintf(stderr, "%s: %ux%u, %u + %u samples...\n", scene->name, width, height, warmup, samples);
+		}
+		results.push_back(RunScene(*scene, width, height, samples, warmup, threads, tileSize, sampler, accel, integrator, packets, reorder, lightSampling));
+		SceneResult& r = results.back();
+		threadCount = r.threads;
+		if (!quiet)
+		{
+			fprintf(stderr, "%s: %zu spheres, %.3f Mrays/s, %.3f Msamples/s, p50 %.2f ms\n", scene->name, r.spheres,
+				static_cast<double>(r.rays) / std::max(r.seconds, 1e-9) * 1e-6, static_cast<double>(r.paths) / std::max(r.seconds, 1e-9) * 1e-6, Percentile(r.frameMs, 50.0));
+		}
+
+		if (checkPackets && RAY_PACKETS)
+		{
+			const SceneResult flipped = RunScene(*scene, width, height, samples, warmup, threads, tileSize, sampler, accel, integrator, !packets, reorder, lightSampling);
+			r.packetsChecked = true;
+			r.packetsIdentical = flipped.imageHash == r.imageHash;
+			mismatches += r.packetsIdentical ? 0 : 1;
+			if (!quiet || !r.packetsIdentical)
+			{
+				fprintf(stderr, "%s: packet and single ray images %s\n", scene->name, r.packetsIdentical ? "match" : "DIFFER");
+			}
+		}
+	}
+	if (checkPackets && !RAY_PACKETS && !quiet)
+	{
+		fprintf(stderr, "built without packet tracing, nothing to check\n");
+	}
+
+	FILE* out = output ? fopen(output, "w") : stdout;
+	if (!out)
+	{
+		fprintf(stderr, "could not open %s\n", output);
+		return EXIT_FAILURE;
+	}
+	WriteReport(out, results, width, height, samples, warmup, threadCount, tileSize, sampler, integrator, packets, reorder, lightSampling);
+	if (output)
+	{
+		fclose(out);
+	}
+	return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
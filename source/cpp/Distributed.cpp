@@ -0,0 +1,554 @@
+#include "../Distributed.h"
+#include "../ImageWriter.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+namespace
+{
+	// rough upper bound for a job's payload, anything larger is a corrupt or hostile stream
+	constexpr uint32_t MAX_MESSAGE_SIZE = 256u << 20;
+
+	constexpr size_t ResultSize(size_t pixelCount) noexcept
+	{
+		return sizeof(DISTRIBUTED::ResultHeader) + pixelCount * (3 * sizeof(float) + sizeof(float) + sizeof(uint32_t));
+	}
+
+	template <typename T>
+	bool ReceivePayload(Socket& socket, const DISTRIBUTED::MessageHeader& header, T& payload) noexcept
+	{
+		return header.size == sizeof(T) && socket.ReceiveAll(&payload, sizeof(T));
+	}
+};
+
+bool DISTRIBUTED::WriteMessage(Socket& socket, MessageType type, const void* payload, uint32_t size) noexcept
+{
+	const MessageHeader header = { static_cast<uint32_t>(type), size };
+	return socket.SendAll(&header, sizeof(header)) && (size == 0 || socket.SendAll(payload, size));
+}
+
+bool DISTRIBUTED::ReadHeader(Socket& socket, MessageHeader& header) noexcept
+{
+	return socket.ReceiveAll(&header, sizeof(header)) && header.size <= MAX_MESSAGE_SIZE;
+}
+
+int DISTRIBUTED::RunWorker(const char* host, uint16_t port, size_t threadCount, bool verbose)
+{
+	if (!Socket::Initialize())
+	{
+		fprintf(stderr, "worker: socket initialization failed\n");
+		return EXIT_FAILURE;
+	}
+
+	// the coordinator may still be starting up, local workers are usually spawned right after it listens
+	Socket socket;
+	bool connected = false;
+	for (int attempt = 0; attempt < 100 && !connected; ++attempt)
+	{
+		connected = socket.Connect(host, port);
+		if (!connected)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+	if (!connected)
+	{
+		fprintf(stderr, "worker: could not connect to %s:%u\n", host, static_cast<unsigned>(port));
+		return EXIT_FAILURE;
+	}
+
+	const Hello hello = { PROTOCOL_MAGIC, PROTOCOL_VERSION };
+	if (!WriteMessage(socket, MessageType::HELLO, &hello, sizeof(hello)))
+	{
+		return EXIT_FAILURE;
+	}
+
+	RaytracingInAWeekend raytracer;
+	raytracer.SetThreadCount(threadCount);
+
+	bool configured = false;
+	uint32_t jobsDone = 0;
+	std::vector<uint8_t> result;
+	MessageHeader header = {};
+	while (ReadHeader(socket, header))
+	{
+		switch (static_cast<MessageType>(header.type))
+		{
+			case MessageType::CONFIG:
+			{
+				Config config = {};
+				if (!ReceivePayload(socket, header, config))
+				{
+					return EXIT_FAILURE;
+				}
+				raytracer.SetSampler(static_cast<SamplerType>(config.sampler));
+				raytracer.SetAccelerationStructure(static_cast<AccelerationStructure>(config.accelerationStructure));
+				raytracer.SetMaxDepth(config.maxDepth);
+				raytracer.SetRouletteStartDepth(config.rouletteStartDepth);
+				raytracer.SetCanvasSize(config.width, config.height);
+
+				configured = raytracer.SampleIdentity() == config.identity;
+				const Ready ready = { configured ? 1u : 0u };
+				if (!WriteMessage(socket, MessageType::READY, &ready, sizeof(ready)))
+				{
+					return EXIT_FAILURE;
+				}
+				if (!configured)
+				{
+					fprintf(stderr, "worker: the coordinator renders another scene or build\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			}
+			case MessageType::JOB:
+			{
+				Job job = {};
+				if (!configured || !ReceivePayload(socket, header, job))
+				{
+					return EXIT_FAILURE;
+				}
+
+				// one contiguous RESULT message: header, RGB sums, squared luminance sums, counts
+				const size_t pixelCount = static_cast<size_t>(job.width) * job.height;
+				result.resize(ResultSize(pixelCount));
+				float* sums = reinterpret_cast<float*>(result.data() + sizeof(ResultHeader));
+				float* luminanceSquared = sums + pixelCount * 3;
+				uint32_t* counts = reinterpret_cast<uint32_t*>(luminanceSquared + pixelCount);
+
+				ResultHeader resultHeader = { job.id, static_cast<uint32_t>(pixelCount), 0 };
+				resultHeader.rays = raytracer.RenderRegion(job.x0, job.y0, job.width, job.height, job.sampleBegin, job.sampleCount, sums, luminanceSquared, counts);
+				memcpy(result.data(), &resultHeader, sizeof(resultHeader));
+
+				if (!WriteMessage(socket, MessageType::RESULT, result.data(), static_cast<uint32_t>(result.size())))
+				{
+					return EXIT_FAILURE;
+				}
+				++jobsDone;
+				break;
+			}
+			case MessageType::SHUTDOWN:
+				if (verbose)
+				{
+					printf("worker: %u jobs, %llu rays\n", jobsDone, static_cast<unsigned long long>(raytracer.RaysTraced()));
+				}
+				return EXIT_SUCCESS;
+			default:
+				fprintf(stderr, "worker: unexpected message %u\n", header.type);
+				return EXIT_FAILURE;
+		}
+	}
+
+	fprintf(stderr, "worker: lost the coordinator\n");
+	return EXIT_FAILURE;
+}
+
+Coordinator::Coordinator(const RaytracingInAWeekend& reference, uint32_t width, uint32_t height, uint32_t samplesPerPixel, uint32_t jobTileSize, uint32_t jobSamples)
+{
+	m_config.width = width;
+	m_config.height = height;
+	m_config.sampler = static_cast<uint32_t>(reference.GetSampler());
+	m_config.accelerationStructure = static_cast<uint32_t>(reference.GetAccelerationStructure());
+	m_config.maxDepth = reference.GetMaxDepth();
+	m_config.rouletteStartDepth = reference.GetRouletteStartDepth();
+	m_config.identity = reference.SampleIdentity();
+
+	jobTileSize = std::max(jobTileSize, 1u);
+	jobSamples = std::max(jobSamples, 1u);
+
+	// sample ranges outermost, so the image converges evenly instead of tile by tile
+	for (uint32_t sampleBegin = 0; sampleBegin < samplesPerPixel; sampleBegin += jobSamples)
+	{
+		for (uint32_t y0 = 0; y0 < height; y0 += jobTileSize)
+		{
+			for (uint32_t x0 = 0; x0 < width; x0 += jobTileSize)
+			{
+				DISTRIBUTED::Job job = {};
+				job.id = static_cast<uint32_t>(m_jobs.size());
+				job.x0 = x0;
+				job.y0 = y0;
+				job.width = std::min(jobTileSize, width - x0);
+				job.height = std::min(jobTileSize, height - y0);
+				job.sampleBegin = sampleBegin;
+				job.sampleCount = std::min(jobSamples, samplesPerPixel - sampleBegin);
+				m_jobs.push_back(job);
+				m_queue.push_back(job.id);
+			}
+		}
+	}
+	m_jobDone.assign(m_jobs.size(), 0);
+	m_jobCopies.assign(m_jobs.size(), 0);
+
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	m_accumulation.assign(pixelCount * 3, 0.0f);
+	m_luminanceSquared.assign(pixelCount, 0.0f);
+	m_sampleCounts.assign(pixelCount, 0);
+}
+
+bool Coordinator::Listen(uint16_t port) noexcept
+{
+	return Socket::Initialize() && m_listener.Listen(port);
+}
+
+bool Coordinator::Run(float workerTimeoutSeconds, float jobTimeoutSeconds, bool verbose)
+{
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<const Socket*> sockets;
+	std::vector<uint8_t> ready;
+
+	const Clock::time_point start = Clock::now();
+	Clock::time_point lastWorkerSeen = start;
+	Clock::time_point lastReport = start;
+
+	while (m_jobsDone < m_jobs.size())
+	{
+		sockets.clear();
+		sockets.push_back(&m_listener);
+		for (const std::unique_ptr<Worker>& worker : workers)
+		{
+			sockets.push_back(&worker->socket);
+		}
+		if (Socket::WaitReadable(sockets, ready, 100) < 0)
+		{
+			return false;
+		}
+
+		if (ready[0])
+		{
+			Socket accepted = m_listener.Accept();
+			if (accepted.IsValid())
+			{
+				// a worker that stops half way through a message must not block the loop
+				accepted.SetReceiveTimeout(static_cast<int>(workerTimeoutSeconds * 1000.0f));
+				workers.push_back(std::make_unique<Worker>());
+				workers.back()->socket = std::move(accepted);
+				workers.back()->connected = Clock::now();
+			}
+		}
+
+		// ready[] is indexed by the sockets gathered above, new workers are checked next round
+		const size_t polledWorkers = sockets.size() - 1;
+		Clock::time_point now = Clock::now();
+		size_t kept = 0;
+		for (size_t i = 0; i < workers.size(); ++i)
+		{
+			Worker& worker = *workers[i];
+			const char* reason = nullptr;
+			if (i < polledWorkers && ready[i + 1] && !HandleMessage(worker))
+			{
+				reason = "dropped";
+			}
+			else if (!worker.ready && std::chrono::duration<float>(now - worker.connected).count() > workerTimeoutSeconds)
+			{
+				reason = "never finished the handshake, dropped";
+			}
+			else if (worker.job >= 0 && std::chrono::duration<float>(now - worker.jobStart).count() > jobTimeoutSeconds)
+			{
+				reason = "hung on a job, dropped";
+			}
+			if (reason)
+			{
+				if (verbose)
+				{
+					printf("worker %zu %s after %u jobs\n", i, reason, worker.jobsDone);
+				}
+				ReleaseJob(worker);
+				continue;
+			}
+			workers[kept++] = std::move(workers[i]);
+		}
+		workers.resize(kept);
+
+		AssignJobs(workers);
+
+		// only workers that can take jobs count, a bare connection does not keep the render alive
+		now = Clock::now();
+		if (std::any_of(workers.begin(), workers.end(), [](const std::unique_ptr<Worker>& worker) { return worker->ready; }))
+		{
+			lastWorkerSeen = now;
+		}
+		else if (std::chrono::duration<float>(now - lastWorkerSeen).count() > workerTimeoutSeconds)
+		{
+			fprintf(stderr, "no worker ready for %.1f s, %zu of %zu jobs done\n", workerTimeoutSeconds, m_jobsDone, m_jobs.size());
+			return false;
+		}
+
+		if (verbose && std::chrono::duration<float>(now - lastReport).count() > 1.0f)
+		{
+			lastReport = now;
+			printf("%zu/%zu jobs, %zu workers, %.1f s\n", m_jobsDone, m_jobs.size(), workers.size(), std::chrono::duration<float>(now - start).count());
+		}
+	}
+
+	for (const std::unique_ptr<Worker>& worker : workers)
+	{
+		DISTRIBUTED::WriteMessage(worker->socket, DISTRIBUTED::MessageType::SHUTDOWN, nullptr, 0);
+	}
+	return true;
+}
+
+bool Coordinator::HandleMessage(Worker& worker)
+{
+	using namespace DISTRIBUTED;
+
+	MessageHeader header = {};
+	if (!ReadHeader(worker.socket, header))
+	{
+		return false;
+	}
+
+	switch (static_cast<MessageType>(header.type))
+	{
+		case MessageType::HELLO:
+		{
+			Hello hello = {};
+			if (!ReceivePayload(worker.socket, header, hello) || hello.magic != PROTOCOL_MAGIC || hello.version != PROTOCOL_VERSION)
+			{
+				return false;
+			}
+			return WriteMessage(worker.socket, MessageType::CONFIG, &m_config, sizeof(m_config));
+		}
+		case MessageType::READY:
+		{
+			Ready answer = {};
+			if (!ReceivePayload(worker.socket, header, answer) || !answer.accepted)
+			{
+				fprintf(stderr, "a worker refused the configuration, it renders another scene or build\n");
+				return false;
+			}
+			worker.ready = true;
+			return true;
+		}
+		case MessageType::RESULT:
+		{
+			ResultHeader result = {};
+			if (header.size < sizeof(result) || !worker.socket.ReceiveAll(&result, sizeof(result)))
+			{
+				return false;
+			}
+			if (worker.job < 0 || result.id != static_cast<uint32_t>(worker.job))
+			{
+				return false;
+			}
+			const Job& job = m_jobs[result.id];
+			const size_t pixelCount = static_cast<size_t>(job.width) * job.height;
+			if (result.pixelCount != pixelCount || header.size != ResultSize(pixelCount))
+			{
+				return false;
+			}
+
+			m_receiveBuffer.resize(header.size - sizeof(result));
+			if (!worker.socket.ReceiveAll(m_receiveBuffer.data(), m_receiveBuffer.size()))
+			{
+				return false;
+			}
+
+			const double seconds = std::chrono::duration<double>(Clock::now() - worker.jobStart).count();
+			--m_jobCopies[result.id];
+			worker.job = -1;
+			++worker.jobsDone;
+
+			// a speculative copy may already have delivered this job, the first result wins
+			if (!m_jobDone[result.id])
+			{
+				const float* sums = reinterpret_cast<const float*>(m_receiveBuffer.data());
+				const float* luminanceSquared = sums + pixelCount * 3;
+				const uint32_t* counts = reinterpret_cast<const uint32_t*>(luminanceSquared + pixelCount);
+				Merge(job, sums, luminanceSquared, counts);
+
+				m_jobDone[result.id] = 1;
+				++m_jobsDone;
+				m_jobSecondsTotal += seconds;
+				m_raysTraced += result.rays;
+				m_pathsTraced += static_cast<uint64_t>(pixelCount) * job.sampleCount;
+			}
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+void Coordinator::AssignJobs(std::vector<std::unique_ptr<Worker>>& workers)
+{
+	const Clock::time_point now = Clock::now();
+	for (std::unique_ptr<Worker>& worker : workers)
+	{
+		if (!worker->ready || worker->job >= 0)
+		{
+			continue;
+		}
+
+		int64_t next = -1;
+		while (!m_queue.empty() && next < 0)
+		{
+			const uint32_t candidate = m_queue.front();
+			m_queue.pop_front();
+			if (!m_jobDone[candidate])
+			{
+				next = candidate;
+			}
+		}
+
+		// Nothing left to hand out: duplicate the job that has been running the longest
+		// if it is well past the average, a straggler or a hung worker then no longer
+		// holds the whole frame back
+		if (next < 0 && m_jobsDone > 0)
+		{
+			const double threshold = std::max(3.0 * m_jobSecondsTotal / static_cast<double>(m_jobsDone), 0.5);
+			double longest = threshold;
+			for (const std::unique_ptr<Worker>& other : workers)
+			{
+				if (other->job < 0 || m_jobDone[other->job] || m_jobCopies[other->job] > 1)
+				{
+					continue;
+				}
+				const double running = std::chrono::duration<double>(now - other->jobStart).count();
+				if (running > longest)
+				{
+					longest = running;
+					next = other->job;
+				}
+			}
+			if (next >= 0)
+			{
+				++m_reassigned;
+			}
+		}
+
+		if (next < 0)
+		{
+			continue;
+		}
+		if (!DISTRIBUTED::WriteMessage(worker->socket, DISTRIBUTED::MessageType::JOB, &m_jobs[next], sizeof(DISTRIBUTED::Job)))
+		{
+			// the failed worker is noticed and dropped on its next poll
+			m_queue.push_front(static_cast<uint32_t>(next));
+			continue;
+		}
+		worker->job = next;
+		worker->jobStart = now;
+		++m_jobCopies[next];
+	}
+}
+
+void Coordinator::ReleaseJob(Worker& worker)
+{
+	if (worker.job < 0)
+	{
+		return;
+	}
+	const uint32_t job = static_cast<uint32_t>(worker.job);
+	worker.job = -1;
+	if (--m_jobCopies[job] == 0 && !m_jobDone[job])
+	{
+		m_queue.push_front(job);
+		++m_reassigned;
+	}
+}
+
+void Coordinator::Merge(const DISTRIBUTED::Job& job, const float* sums, const float* luminanceSquared, const uint32_t* counts) noexcept
+{
+	// every job carries its own sample counts, so the accumulation stays a plain sum
+	// and averaging by the per pixel count weights each job by the samples it took
+	for (uint32_t row = 0; row < job.height; ++row)
+	{
+		const size_t source = static_cast<size_t>(row) * job.width;
+		const size_t target = static_cast<size_t>(job.y0 + row) * m_config.width + job.x0;
+		for (uint32_t column = 0; column < job.width; ++column)
+		{
+			m_accumulation[(target + column) * 3    ] += sums[(source + column) * 3    ];
+			m_accumulation[(target + column) * 3 + 1] += sums[(source + column) * 3 + 1];
+			m_accumulation[(target + column) * 3 + 2] += sums[(source + column) * 3 + 2];
+			m_luminanceSquared[target + column] += luminanceSquared[source + column];
+			m_sampleCounts[target + column] += counts[source + column];
+		}
+	}
+}
+
+bool Coordinator::WriteImage(const char* path) const
+{
+	ImageWriter writer;
+	return writer.Open(path, ImageFormatFromPath(path), m_config.width, m_config.height)
+		&& writer.WriteRows(0, m_config.height, m_accumulation.data(), m_sampleCounts.data())
+		&& writer.Close();
+}
+
+bool LocalWorkers::Spawn(const char* executable, uint16_t port, size_t count, size_t threadsPerWorker)
+{
+	const std::string portText = std::to_string(port);
+	const std::string address = "127.0.0.1:" + portText;
+	const std::string threads = std::to_string(threadsPerWorker);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+#ifdef _WIN32
+		std::string commandLine = std::string("\"") + executable + "\" --worker " + address + " --threads " + threads + " --quiet";
+		STARTUPINFOA startup = {};
+		startup.cb = sizeof(startup);
+		PROCESS_INFORMATION process = {};
+		if (!CreateProcessA(executable, commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &process))
+		{
+			return false;
+		}
+		CloseHandle(process.hThread);
+		m_processes.push_back(process.hProcess);
+#else
+		const char* arguments[] = { executable, "--worker", address.c_str(), "--threads", threads.c_str(), "--quiet", nullptr };
+		pid_t pid = 0;
+		if (posix_spawn(&pid, executable, nullptr, nullptr, const_cast<char* const*>(arguments), environ) != 0)
+		{
+			return false;
+		}
+		m_processes.push_back(pid);
+#endif
+	}
+	return true;
+}
+
+void LocalWorkers::Wait(float timeoutSeconds) noexcept
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<float>(timeoutSeconds);
+#ifdef _WIN32
+	for (void* process : m_processes)
+	{
+		const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if (WaitForSingleObject(process, static_cast<DWORD>(std::max<long long>(remaining, 0))) != WAIT_OBJECT_0)
+		{
+			TerminateProcess(process, EXIT_FAILURE);
+			WaitForSingleObject(process, INFINITE);
+		}
+		CloseHandle(process);
+	}
+#else
+	for (int pid : m_processes)
+	{
+		int status = 0;
+		while (waitpid(pid, &status, WNOHANG) == 0)
+		{
+			if (std::chrono::steady_clock::now() >= deadline)
+			{
+				kill(pid, SIGKILL);
+				waitpid(pid, &status, 0);
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+#endif
+	m_processes.clear();
+}
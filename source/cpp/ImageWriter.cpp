@@ -0,0 +1,387 @@
+#include "../ImageWriter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	struct CRCTable
+	{
+		uint32_t v[256] = {};
+	};
+
+	// CRC-32 as used by PNG chunks (reflected, polynomial 0xEDB88320)
+	constexpr CRCTable MakeCRCTable() noexcept
+	{
+		CRCTable table;
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k)
+			{
+				c = (c & 1u) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table.v[n] = c;
+		}
+		return table;
+	}
+
+	constexpr CRCTable CRC_TABLE = MakeCRCTable();
+
+	// largest stored deflate block, and the most bytes Adler-32 can sum before its
+	// 32 bit accumulators have to be reduced
+	constexpr uint32_t STORED_BLOCK_SIZE = 65535;
+	constexpr uint32_t ADLER_MOD = 65521;
+	constexpr size_t ADLER_NMAX = 5552;
+
+	uint8_t ToByte(float value) noexcept
+	{
+		return static_cast<uint8_t>(fminf(fmaxf(value, 0.0f), 1.0f) * 255.0f);
+	}
+
+	void PutBigEndian(uint8_t* out, uint32_t value) noexcept
+	{
+		out[0] = static_cast<uint8_t>(value >> 24);
+		out[1] = static_cast<uint8_t>(value >> 16);
+		out[2] = static_cast<uint8_t>(value >> 8);
+		out[3] = static_cast<uint8_t>(value);
+	}
+};
+
+ImageFormat ImageFormatFromPath(std::string_view path) noexcept
+{
+	const auto endsWith = [path](std::string_view extension) noexcept
+		{
+			if (path.size() < extension.size())
+			{
+				return false;
+			}
+			for (size_t i = 0; i < extension.size(); ++i)
+			{
+				const char c = path[path.size() - extension.size() + i];
+				if ((c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c) != extension[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+	if (endsWith(".png"))
+	{
+		return ImageFormat::PNG;
+	}
+	if (endsWith(".pfm"))
+	{
+		return ImageFormat::PFM;
+	}
+	return ImageFormat::PPM;
+}
+
+ImageWriter::~ImageWriter()
+{
+	if (m_file)
+	{
+		Close();
+	}
+}
+
+bool ImageWriter::Open(const char* path, ImageFormat format, uint32_t width, uint32_t height)
+{
+	if (m_file)
+	{
+		Close();
+	}
+	if (width == 0 || height == 0)
+	{
+		return false;
+	}
+
+	m_file = fopen(path, "wb");
+	if (!m_file)
+	{
+		return false;
+	}
+
+	m_format = format;
+	m_width = width;
+	m_height = height;
+	m_ok = true;
+	m_pendingRows.clear();
+	m_nextRow = 0;
+
+	char header[64];
+	switch (format)
+	{
+		case ImageFormat::PFM:
+		{
+			// negative scale marks little endian floats
+			const int length = snprintf(header, sizeof(header), "PF\n%u %u\n-1.0\n", width, height);
+			Write(header, static_cast<size_t>(length));
+			m_dataOffset = static_cast<uint64_t>(length);
+			break;
+		}
+		case ImageFormat::PNG:
+		{
+			static constexpr uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			Write(signature, sizeof(signature));
+
+			uint8_t ihdr[13] = {};
+			PutBigEndian(ihdr, width);
+			PutBigEndian(ihdr + 4, height);
+			ihdr[8] = 8; // bit depth
+			ihdr[9] = 2; // truecolor RGB
+			BeginPNGChunk("IHDR", sizeof(ihdr));
+			WriteChunkBytes(ihdr, sizeof(ihdr));
+			EndPNGChunk();
+
+			// every row is a filter byte (0, none) followed by the pixels
+			m_deflateTotal = static_cast<uint64_t>(height) * (1 + static_cast<uint64_t>(width) * 3);
+			m_deflateRemaining = m_deflateTotal;
+			m_blockRemaining = 0;
+			m_adlerA = 1;
+			m_adlerB = 0;
+			break;
+		}
+		default:
+		{
+			const int length = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+			Write(header, static_cast<size_t>(length));
+			m_dataOffset = static_cast<uint64_t>(length);
+			break;
+		}
+	}
+	return m_ok;
+}
+
+bool ImageWriter::WriteTile(uint32_t x0, uint32_t y0, uint32_t tileWidth, uint32_t tileHeight, const float* sums, size_t sumStride, const uint32_t* counts, size_t countStride)
+{
+	if (!m_file || x0 + tileWidth > m_width || y0 + tileHeight > m_height)
+	{
+		return false;
+	}
+
+	for (uint32_t row = 0; row < tileHeight; ++row)
+	{
+		const uint32_t y = y0 + row;
+		const float* rowSums = sums + row * sumStride;
+		const uint32_t* rowCounts = counts ? counts + row * countStride : nullptr;
+		const auto scale = [rowCounts](uint32_t x) noexcept -> float
+			{
+				if (!rowCounts)
+				{
+					return 1.0f;
+				}
+				return rowCounts[x] > 0 ? 1.0f / rowCounts[x] : 0.0f;
+			};
+
+		switch (m_format)
+		{
+			case ImageFormat::PFM:
+			{
+				// PFM rows run bottom to top
+				m_rowScratch.resize(static_cast<size_t>(tileWidth) * 3 * sizeof(float));
+				float* out = reinterpret_cast<float*>(m_rowScratch.data());
+				for (uint32_t x = 0; x < tileWidth; ++x)
+				{
+					const float s = scale(x);
+					out[x * 3    ] = rowSums[x * 3    ] * s;
+					out[x * 3 + 1] = rowSums[x * 3 + 1] * s;
+					out[x * 3 + 2] = rowSums[x * 3 + 2] * s;
+				}
+				const uint64_t pixel = static_cast<uint64_t>(m_height - 1 - y) * m_width + x0;
+				if (Seek(m_dataOffset + pixel * 3 * sizeof(float)))
+				{
+					Write(out, m_rowScratch.size());
+				}
+				break;
+			}
+			case ImageFormat::PNG:
+			{
+				if (y < m_nextRow)
+				{
+					m_ok = false;
+					break;
+				}
+				PendingRow& pending = m_pendingRows[y];
+				pending.pixels.resize(static_cast<size_t>(m_width) * 3);
+				uint8_t* out = pending.pixels.data() + static_cast<size_t>(x0) * 3;
+				for (uint32_t x = 0; x < tileWidth; ++x)
+				{
+					const float s = scale(x);
+					out[x * 3    ] = ToByte(rowSums[x * 3    ] * s);
+					out[x * 3 + 1] = ToByte(rowSums[x * 3 + 1] * s);
+					out[x * 3 + 2] = ToByte(rowSums[x * 3 + 2] * s);
+				}
+				pending.written += tileWidth;
+
+				// emit every row that is complete and has no gap above it
+				while (!m_pendingRows.empty() && m_pendingRows.begin()->first == m_nextRow && m_pendingRows.begin()->second.written >= m_width)
+				{
+					WritePNGRow(m_pendingRows.begin()->second.pixels.data());
+					m_pendingRows.erase(m_pendingRows.begin());
+					++m_nextRow;
+				}
+				break;
+			}
+			default:
+			{
+				m_rowScratch.resize(static_cast<size_t>(tileWidth) * 3);
+				uint8_t* out = m_rowScratch.data();
+				for (uint32_t x = 0; x < tileWidth; ++x)
+				{
+					const float s = scale(x);
+					out[x * 3    ] = ToByte(rowSums[x * 3    ] * s);
+					out[x * 3 + 1] = ToByte(rowSums[x * 3 + 1] * s);
+					out[x * 3 + 2] = ToByte(rowSums[x * 3 + 2] * s);
+				}
+				const uint64_t pixel = static_cast<uint64_t>(y) * m_width + x0;
+				if (Seek(m_dataOffset + pixel * 3))
+				{
+					Write(out, m_rowScratch.size());
+				}
+				break;
+			}
+		}
+	}
+
+	return m_ok;
+}
+
+bool ImageWriter::Close()
+{
+	if (!m_file)
+	{
+		return false;
+	}
+
+	if (m_format == ImageFormat::PNG)
+	{
+		if (m_nextRow != m_height)
+		{
+			m_ok = false;
+		}
+		else
+		{
+			BeginPNGChunk("IEND", 0);
+			EndPNGChunk();
+		}
+		m_pendingRows.clear();
+	}
+
+	const bool closed = fclose(m_file) == 0;
+	m_file = nullptr;
+	return closed && m_ok;
+}
+
+bool ImageWriter::Seek(uint64_t offset) noexcept
+{
+#ifdef _WIN32
+	const bool ok = _fseeki64(m_file, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+	const bool ok = fseeko(m_file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+	m_ok &= ok;
+	return ok;
+}
+
+void ImageWriter::Write(const void* data, size_t size) noexcept
+{
+	m_ok &= fwrite(data, 1, size, m_file) == size;
+}
+
+void ImageWriter::WritePNGRow(const uint8_t* pixels) noexcept
+{
+	const uint8_t filter = 0;
+	WritePNGData(&filter, 1);
+	WritePNGData(pixels, static_cast<size_t>(m_width) * 3);
+}
+
+// Raw zlib data goes out as stored deflate blocks, the sizes of which are known up
+// front, so every block becomes one IDAT chunk without buffering anything
+void ImageWriter::WritePNGData(const uint8_t* data, size_t size) noexcept
+{
+	while (size > 0)
+	{
+		if (m_blockRemaining == 0)
+		{
+			const bool first = m_deflateRemaining == m_deflateTotal;
+			m_blockRemaining = static_cast<uint32_t>(std::min<uint64_t>(STORED_BLOCK_SIZE, m_deflateRemaining));
+			const bool last = m_blockRemaining == m_deflateRemaining;
+
+			BeginPNGChunk("IDAT", (first ? 2 : 0) + 5 + m_blockRemaining + (last ? 4 : 0));
+			if (first)
+			{
+				// deflate with a 32K window, no preset dictionary, fastest level
+				static constexpr uint8_t zlibHeader[2] = { 0x78, 0x01 };
+				WriteChunkBytes(zlibHeader, sizeof(zlibHeader));
+			}
+			const uint16_t length = static_cast<uint16_t>(m_blockRemaining);
+			const uint8_t blockHeader[5] =
+			{
+				static_cast<uint8_t>(last ? 1 : 0),
+				static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+				static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8)
+			};
+			WriteChunkBytes(blockHeader, sizeof(blockHeader));
+		}
+
+		const size_t count = std::min<size_t>(size, m_blockRemaining);
+		WriteChunkBytes(data, count);
+
+		for (size_t done = 0; done < count; )
+		{
+			const size_t run = std::min(ADLER_NMAX, count - done);
+			for (size_t i = 0; i < run; ++i)
+			{
+				m_adlerA += data[done + i];
+				m_adlerB += m_adlerA;
+			}
+			m_adlerA %= ADLER_MOD;
+			m_adlerB %= ADLER_MOD;
+			done += run;
+		}
+
+		data += count;
+		size -= count;
+		m_blockRemaining -= static_cast<uint32_t>(count);
+		m_deflateRemaining -= count;
+
+		if (m_blockRemaining == 0)
+		{
+			if (m_deflateRemaining == 0)
+			{
+				uint8_t adler[4];
+				PutBigEndian(adler, (m_adlerB << 16) | m_adlerA);
+				WriteChunkBytes(adler, sizeof(adler));
+			}
+			EndPNGChunk();
+		}
+	}
+}
+
+void ImageWriter::WriteChunkBytes(const void* data, size_t size) noexcept
+{
+	Write(data, size);
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		m_crc = CRC_TABLE.v[(m_crc ^ bytes[i]) & 0xFFu] ^ (m_crc >> 8);
+	}
+}
+
+void ImageWriter::BeginPNGChunk(const char* type, uint32_t length) noexcept
+{
+	uint8_t lengthBytes[4];
+	PutBigEndian(lengthBytes, length);
+	Write(lengthBytes, sizeof(lengthBytes));
+
+	m_crc = 0xFFFFFFFFu;
+	WriteChunkBytes(type, 4);
+}
+
+void ImageWriter::EndPNGChunk() noexcept
+{
+	uint8_t crc[4];
+	PutBigEndian(crc, m_crc ^ 0xFFFFFFFFu);
+	Write(crc, sizeof(crc));
+}
@@ -0,0 +1,140 @@
+#include "../MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include "Windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* path, size_t size, bool& existed)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	existed = GetLastError() == ERROR_ALREADY_EXISTS;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || (existed && static_cast<uint64_t>(fileSize.QuadPart) != size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// a mapping larger than the file grows it, zero filled
+	const uint64_t mappingSize = size;
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize), nullptr);
+	void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : nullptr;
+	if (!data)
+	{
+		if (mapping)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_data = data;
+	m_size = size;
+	return true;
+}
+
+void MappedFile::Close() noexcept
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+	if (m_file)
+	{
+		CloseHandle(m_file);
+		m_file = nullptr;
+	}
+	m_size = 0;
+}
+
+bool MappedFile::Flush() noexcept
+{
+	return m_data && FlushViewOfFile(m_data, m_size) && FlushFileBuffers(m_file);
+}
+
+#else
+
+bool MappedFile::Open(const char* path, size_t size, bool& existed)
+{
+	Close();
+
+	const int file = open(path, O_RDWR | O_CREAT, 0644);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat status = {};
+	if (fstat(file, &status) != 0)
+	{
+		close(file);
+		return false;
+	}
+	existed = status.st_size > 0;
+	if ((existed && static_cast<uint64_t>(status.st_size) != size) || (!existed && ftruncate(file, static_cast<off_t>(size)) != 0))
+	{
+		close(file);
+		return false;
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (data == MAP_FAILED)
+	{
+		close(file);
+		return false;
+	}
+
+	m_file = file;
+	m_data = data;
+	m_size = size;
+	return true;
+}
+
+void MappedFile::Close() noexcept
+{
+	if (m_data)
+	{
+		munmap(m_data, m_size);
+		m_data = nullptr;
+	}
+	if (m_file >= 0)
+	{
+		close(m_file);
+		m_file = -1;
+	}
+	m_size = 0;
+}
+
+bool MappedFile::Flush() noexcept
+{
+	return m_data && msync(m_data, m_size, MS_SYNC) == 0;
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include "../MathBench.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+// Microbenchmarks of the SIMD kernels in Maths.h against the scalar NaiveMath.h ones
+// the tracer uses. Every kernel runs over the same inputs in both implementations,
+// reports ns per operation and a checksum so a faster kernel that computes something
+// else (FastSqrt's approximation, Schlick without powf) shows up next to its timing
+
+namespace
+{
+	MATH_BENCH::Data MakeData(uint32_t seed)
+	{
+		using namespace MATH_BENCH;
+
+		std::minstd_rand generator(seed);
+		const auto random = [&generator](float min, float max)
+			{
+				const double unit = static_cast<double>(generator() - std::minstd_rand::min()) / static_cast<double>(std::minstd_rand::max() - std::minstd_rand::min() + 1);
+				return static_cast<float>(min + (max - min) * unit);
+			};
+		const auto push3 = [](std::vector<float>& values, float x, float y, float z)
+			{
+				values.push_back(x);
+				values.push_back(y);
+				values.push_back(z);
+			};
+
+		Data data;
+		for (size_t i = 0; i < COUNT; ++i)
+		{
+			const float ax = random(-4.0f, 4.0f), ay = random(-4.0f, 4.0f), az = random(-4.0f, 4.0f);
+			push3(data.a, ax, ay, az);
+			push3(data.b, random(-4.0f, 4.0f), random(-4.0f, 4.0f), random(-4.0f, 4.0f));
+
+			float nx = random(-1.0f, 1.0f), ny = random(-1.0f, 1.0f), nz = random(-1.0f, 1.0f);
+			const float length = sqrtf(nx * nx + ny * ny + nz * nz) + 1e-6f;
+			const float facing = nx * ax + ny * ay + nz * az > 0.0f ? -1.0f : 1.0f;
+			push3(data.normals, facing * nx / length, facing * ny / length, facing * nz / length);
+
+			data.scalars.push_back(random(0.0f, 1.0f));
+			data.ratios.push_back(random(0.6f, 1.6f));
+
+			const float cx = random(-10.0f, 10.0f), cy = random(-10.0f, 10.0f), cz = random(-10.0f, 10.0f);
+			const float radius = random(0.2f, 2.0f);
+			const float ox = random(-10.0f, 10.0f), oy = random(-10.0f, 10.0f), oz = random(-10.0f, 10.0f);
+			push3(data.centers, cx, cy, cz);
+			data.radii.push_back(radius);
+			push3(data.origins, ox, oy, oz);
+			// aimed at a point within two radii of the center, roughly half of the rays hit
+			push3(data.directions, cx + random(-2.0f, 2.0f) * radius - ox, cy + random(-2.0f, 2.0f) * radius - oy, cz + random(-2.0f, 2.0f) * radius - oz);
+		}
+
+		for (size_t m = 0; m < MATRICES; ++m)
+		{
+			for (size_t element = 0; element < 16; ++element)
+			{
+				data.matrices.push_back(random(-1.0f, 1.0f) + (element % 5 == 0 ? 4.0f : 0.0f));
+			}
+		}
+		return data;
+	}
+};
+
+int main(int argc, char** argv)
+{
+	const char* jsonPath = nullptr;
+	uint32_t seed = 1;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--json") && i + 1 < argc) jsonPath = argv[++i];
+		else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = static_cast<uint32_t>(atoi(argv[++i]));
+		else
+		{
+			printf("usage: %s [--json PATH] [--seed N]\n", argv[0]);
+			return !strcmp(argv[i], "--help") ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	const MATH_BENCH::Data data = MakeData(seed);
+	std::vector<MATH_BENCH::Result> scalar;
+	std::vector<MATH_BENCH::Result> simd;
+	MATH_BENCH::RunScalar(data, scalar);
+	MATH_BENCH::RunSimd(data, simd);
+
+	// one row per SIMD variant and scalar kernel of the same name, schlick is timed
+	// against both the powf and the multiplying scalar version
+	printf("%-14s %-22s %10s %-14s %10s %8s %10s\n", "kernel", "simd", "ns/op", "scalar", "ns/op", "speedup", "checksum");
+	for (const MATH_BENCH::Result& vector : simd)
+	{
+		for (const MATH_BENCH::Result& reference : scalar)
+		{
+			if (strcmp(vector.kernel, reference.kernel))
+			{
+				continue;
+			}
+			const double difference = fabs(vector.checksum - reference.checksum) / fmax(fabs(reference.checksum), 1e-6);
+			printf("%-14s %-22s %10.3f %-14s %10.3f %7.2fx %9.2e\n", vector.kernel, vector.implementation, vector.nanoseconds,
+				reference.implementation, reference.nanoseconds, reference.nanoseconds / vector.nanoseconds, difference);
+		}
+	}
+
+	if (jsonPath)
+	{
+		FILE* out = fopen(jsonPath, "w");
+		if (!out)
+		{
+			fprintf(stderr, "could not open %s\n", jsonPath);
+			return EXIT_FAILURE;
+		}
+		fprintf(out, "{\n  \"seed\": %u,\n  \"results\": [\n", seed);
+		const size_t total = scalar.size() + simd.size();
+		size_t written = 0;
+		for (const std::vector<MATH_BENCH::Result>* set : { &scalar, &simd })
+		{
+			for (const MATH_BENCH::Result& result : *set)
+			{
+				fprintf(out, "    { \"kernel\": \"%s\", \"implementation\": \"%s\", \"ns_per_op\": %.4f, \"checksum\": %.6g }%s\n",
+					result.kernel, result.implementation, result.nanoseconds, result.checksum, ++written < total ? "," : "");
+			}
+		}
+		fprintf(out, "  ]\n}\n");
+		fclose(out);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+#include "../MathBench.h"
+#include "../NaiveMath.h"
+#include "../Sphere.h"
+#include <cmath>
+
+namespace
+{
+	Vec3f Load(const std::vector<float>& values, size_t i) noexcept
+	{
+		return Vec3f(values[i * 3], values[i * 3 + 1], values[i * 3 + 2]);
+	}
+
+	float Sum(const Vec3f& v) noexcept
+	{
+		return v.x + v.y + v.z;
+	}
+
+	void Multiply(const float* a, const float* b, float* out) noexcept
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				out[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column] + a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+			}
+		}
+	}
+
+	// schlick() with (1 - cos)^5 by multiplication like the SIMD Schlick4, so that pair
+	// measures the vectorization alone and this one against schlick() the powf
+	float SchlickMultiply(float cosine, float refractionIndex) noexcept
+	{
+		float r0 = (1.0f - refractionIndex) / (1.0f + refractionIndex);
+		r0 *= r0;
+
+		const float x = 1.0f - cosine;
+		const float x2 = x * x;
+		return r0 + (1.0f - r0) * (x2 * x2 * x);
+	}
+
+	// adjugate from the 2x2 sub-determinants of the upper and lower row pairs
+	void Invert(const float* m, float* out) noexcept
+	{
+		const float s0 = m[0] * m[5] - m[4] * m[1];
+		const float s1 = m[0] * m[6] - m[4] * m[2];
+		const float s2 = m[0] * m[7] - m[4] * m[3];
+		const float s3 = m[1] * m[6] - m[5] * m[2];
+		const float s4 = m[1] * m[7] - m[5] * m[3];
+		const float s5 = m[2] * m[7] - m[6] * m[3];
+
+		const float c5 = m[10] * m[15] - m[14] * m[11];
+		const float c4 = m[9] * m[15] - m[13] * m[11];
+		const float c3 = m[9] * m[14] - m[13] * m[10];
+		const float c2 = m[8] * m[15] - m[12] * m[11];
+		const float c1 = m[8] * m[14] - m[12] * m[10];
+		const float c0 = m[8] * m[13] - m[12] * m[9];
+
+		const float invDet = 1.0f / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+		out[0]  = ( m[5] * c5 - m[6] * c4 + m[7] * c3) * invDet;
+		out[1]  = (-m[1] * c5 + m[2] * c4 - m[3] * c3) * invDet;
+		out[2]  = ( m[13] * s5 - m[14] * s4 + m[15] * s3) * invDet;
+		out[3]  = (-m[9] * s5 + m[10] * s4 - m[11] * s3) * invDet;
+		out[4]  = (-m[4] * c5 + m[6] * c2 - m[7] * c1) * invDet;
+		out[5]  = ( m[0] * c5 - m[2] * c2 + m[3] * c1) * invDet;
+		out[6]  = (-m[12] * s5 + m[14] * s2 - m[15] * s1) * invDet;
+		out[7]  = ( m[8] * s5 - m[10] * s2 + m[11] * s1) * invDet;
+		out[8]  = ( m[4] * c4 - m[5] * c2 + m[7] * c0) * invDet;
+		out[9]  = (-m[0] * c4 + m[1] * c2 - m[3] * c0) * invDet;
+		out[10] = ( m[12] * s4 - m[13] * s2 + m[15] * s0) * invDet;
+		out[11] = (-m[8] * s4 + m[9] * s2 - m[11] * s0) * invDet;
+		out[12] = (-m[4] * c3 + m[5] * c1 - m[6] * c0) * invDet;
+		out[13] = ( m[0] * c3 - m[1] * c1 + m[2] * c0) * invDet;
+		out[14] = (-m[12] * s3 + m[13] * s1 - m[14] * s0) * invDet;
+		out[15] = ( m[8] * s3 - m[9] * s1 + m[10] * s0) * invDet;
+	}
+};
+
+void MATH_BENCH::RunScalar(const Data& data, std::vector<Result>& results)
+{
+	const char* naive = "NaiveMath";
+
+	results.push_back(Measure("dot", naive, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += dot(Load(data.a, i), Load(data.b, i));
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("cross", naive, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += Sum(cross(Load(data.a, i), Load(data.b, i)));
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("normalize", naive, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += Sum(unit_vector(Load(data.a, i)));
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("reflect", naive, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += Sum(reflect(Load(data.a, i), Load(data.normals, i)));
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("refract", naive, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				Vec3f refracted;
+				if (refract(Load(data.a, i), Load(data.normals, i), data.ratios[i], refracted))
+				{
+					sum += Sum(refracted);
+				}
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("schlick", naive, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += schlick(data.scalars[i], 1.0f + data.ratios[i]);
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("schlick", "NaiveMath x^5", COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += SchlickMultiply(data.scalars[i], 1.0f + data.ratios[i]);
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("sqrt", "sqrtf", COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += sqrtf(data.scalars[i]);
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("mat4 multiply", "float[16]", MATRICES, [&]() noexcept
+		{
+			float sum = 0.0f;
+			float product[16];
+			for (size_t i = 0; i < MATRICES; ++i)
+			{
+				Multiply(&data.matrices[i * 16], &data.matrices[((i + 1) % MATRICES) * 16], product);
+				sum += product[0] + product[5] + product[10] + product[15];
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("mat4 invert", "float[16]", MATRICES, [&]() noexcept
+		{
+			float sum = 0.0f;
+			float inverse[16];
+			for (size_t i = 0; i < MATRICES; ++i)
+			{
+				Invert(&data.matrices[i * 16], inverse);
+				sum += inverse[0] + inverse[5] + inverse[10] + inverse[15];
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("sphere hit", "Sphere::HIT", COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			HitRegistry rec;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				const Sphere sphere(data.radii[i], Load(data.centers, i));
+				if (sphere.HIT(Ray{ Load(data.origins, i), Load(data.directions, i) }, &rec, 0.001f, 1e30f))
+				{
+					sum += rec.t + Sum(rec.normal);
+				}
+			}
+			return sum;
+		}));
+}
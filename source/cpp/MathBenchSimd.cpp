@@ -0,0 +1,213 @@
+#include "../MathBench.h"
+#include "../Maths.h"
+
+namespace
+{
+	Tuple::Vector Load(const std::vector<float>& values, size_t i, float w = 0.0f) noexcept
+	{
+		return Tuple::Vector(values[i * 3], values[i * 3 + 1], values[i * 3 + 2], w);
+	}
+
+	float Sum(const Tuple::Vector& v) noexcept
+	{
+		return v.x + v.y + v.z;
+	}
+
+	// Maths.h has no refract, Schlick or sphere test, these mirror NaiveMath.h and
+	// Sphere::HIT with its types so the two can be compared
+
+	bool Refract(const Tuple::Vector& incident, const Tuple::Vector& normal, float ratio, Tuple::Vector& refracted) noexcept
+	{
+		const Tuple::Vector unit = Tuple::Normalize(incident);
+		const float cosine = Tuple::DotProduct(unit, normal);
+		const float discriminant = 1.0f - ratio * ratio * (1.0f - cosine * cosine);
+		if (discriminant <= 0.0f)
+		{
+			return false;
+		}
+		const __m128 tangent = _mm_mul_ps(_mm_set_ps1(ratio), _mm_fnmadd_ps(_mm_set_ps1(cosine), normal.v_XYZW, unit.v_XYZW));
+		refracted = Tuple::Vector(_mm_fnmadd_ps(_mm_set_ps1(sqrtf(discriminant)), normal.v_XYZW, tangent));
+		return true;
+	}
+
+	// four cosines at once, (1 - cos)^5 by multiplication instead of powf
+	__m128 Schlick4(__m128 cosine, __m128 refractionIndex) noexcept
+	{
+		const __m128 one = _mm_set_ps1(1.0f);
+		__m128 r0 = _mm_div_ps(_mm_sub_ps(one, refractionIndex), _mm_add_ps(one, refractionIndex));
+		r0 = _mm_mul_ps(r0, r0);
+
+		const __m128 x = _mm_sub_ps(one, cosine);
+		const __m128 x2 = _mm_mul_ps(x, x);
+		const __m128 x5 = _mm_mul_ps(_mm_mul_ps(x2, x2), x);
+		return _mm_fmadd_ps(_mm_sub_ps(one, r0), x5, r0);
+	}
+
+	bool SphereHit(const Tuple::Vector& origin, const Tuple::Vector& direction, const Tuple::Vector& center, float radius, float tMin, float tMax, float& tHit, Tuple::Vector& normal) noexcept
+	{
+		const Tuple::Vector oc(_mm_sub_ps(origin.v_XYZW, center.v_XYZW));
+		const float a = Tuple::DotProduct(direction, direction);
+		const float b = Tuple::DotProduct(oc, direction);
+		const float c = Tuple::DotProduct(oc, oc) - radius * radius;
+		const float discriminant = b * b - a * c;
+		if (discriminant <= 0.0f)
+		{
+			return false;
+		}
+
+		const float sqrtD = sqrtf(discriminant);
+		float t = (-b - sqrtD) / a;
+		if (t >= tMax || t <= tMin)
+		{
+			t = (-b + sqrtD) / a;
+			if (t >= tMax || t <= tMin)
+			{
+				return false;
+			}
+		}
+
+		const __m128 point = _mm_fmadd_ps(_mm_set_ps1(t), direction.v_XYZW, origin.v_XYZW);
+		normal = Tuple::Vector(_mm_div_ps(_mm_sub_ps(point, center.v_XYZW), _mm_set_ps1(radius)));
+		tHit = t;
+		return true;
+	}
+};
+
+void MATH_BENCH::RunSimd(const Data& data, std::vector<Result>& results)
+{
+	const char* simd = "Maths.h";
+
+	results.push_back(Measure("dot", simd, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += Tuple::DotProduct(Load(data.a, i), Load(data.b, i));
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("cross", simd, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += Sum(Tuple::CrossProduct(Load(data.a, i), Load(data.b, i)));
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("normalize", simd, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += Sum(Tuple::Normalize(Load(data.a, i)));
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("normalize", "Maths.h NormalizeXYZ", COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += Sum(Tuple::NormalizeXYZ(Load(data.a, i)));
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("reflect", simd, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += Sum(Tuple::Reflect(Load(data.a, i), Load(data.normals, i)));
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("refract", simd, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				Tuple::Vector refracted;
+				if (Refract(Load(data.a, i), Load(data.normals, i), data.ratios[i], refracted))
+				{
+					sum += Sum(refracted);
+				}
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("schlick", "Maths.h x4", COUNT, [&]() noexcept
+		{
+			const __m128 one = _mm_set_ps1(1.0f);
+			__m128 sum = _mm_setzero_ps();
+			for (size_t i = 0; i < COUNT; i += 4)
+			{
+				sum = _mm_add_ps(sum, Schlick4(_mm_loadu_ps(&data.scalars[i]), _mm_add_ps(one, _mm_loadu_ps(&data.ratios[i]))));
+			}
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, sum);
+			return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		}));
+
+	results.push_back(Measure("sqrt", "FastSqrt", COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				sum += FastSqrt(data.scalars[i]);
+			}
+			return sum;
+		}));
+
+	// loaded up front, the scalar side reads its float[16] in place as well
+	std::vector<Matrix4x4f> matrices;
+	matrices.reserve(MATRICES);
+	for (size_t i = 0; i < MATRICES; ++i)
+	{
+		std::array<float, 16> elements;
+		std::copy_n(&data.matrices[i * 16], 16, elements.begin());
+		matrices.emplace_back(elements);
+	}
+
+	results.push_back(Measure("mat4 multiply", "Matrix4x4f", MATRICES, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < MATRICES; ++i)
+			{
+				const Matrix4x4f product = matrices[i] * matrices[(i + 1) % MATRICES];
+				sum += product.Matrix.elements[0] + product.Matrix.elements[5] + product.Matrix.elements[10] + product.Matrix.elements[15];
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("mat4 invert", "Matrix4x4f", MATRICES, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < MATRICES; ++i)
+			{
+				const Matrix4x4f inverse = matrices[i].Invert();
+				sum += inverse.Matrix.elements[0] + inverse.Matrix.elements[5] + inverse.Matrix.elements[10] + inverse.Matrix.elements[15];
+			}
+			return sum;
+		}));
+
+	results.push_back(Measure("sphere hit", simd, COUNT, [&]() noexcept
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				float t = 0.0f;
+				Tuple::Vector normal;
+				if (SphereHit(Load(data.origins, i, 1.0f), Load(data.directions, i), Load(data.centers, i, 1.0f), data.radii[i], 0.001f, 1e30f, t, normal))
+				{
+					sum += t + Sum(normal);
+				}
+			}
+			return sum;
+		}));
+}
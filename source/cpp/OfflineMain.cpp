@@ -0,0 +1,347 @@
+#include "../Distributed.h"
+#include "../Raytracer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Headless entry point for batch nodes: renders the scene for a sample count and/or a
+// time budget, prints the throughput and streams the image to disk tile by tile. The
+// same executable coordinates or serves distributed renders (see Distributed.h)
+
+static void PrintUsage(const char* program)
+{
+	printf("usage: %s [options]\n"
+		"  --width N         image width (1280)\n"
+		"  --height N        image height (768)\n"
+		"  --samples N       samples per pixel, 0 for no limit (64)\n"
+		"  --seconds S       time budget, 0 for no limit (0)\n"
+		"  --threads N       worker threads, 0 for every hardware thread (0)\n"
+		"  --tile N          tile size in pixels (16)\n"
+		"  --threshold E     adaptive sampling relative error, 0 disables it (0.01)\n"
+		"  --sampler NAME    independent | sobol | rank1 (sobol)\n"
+		"  --accel NAME      linear | bvh2 | bvh4 | bvh8 (bvh8)\n"
+		"  --integrator NAME megakernel | wavefront, one batch per tile (megakernel)\n"
+		"  --packets on|off  trace camera rays in 8 ray packets, needs AVX2 (off)\n"
+		"  --reorder on|off  sort wavefront secondary rays by origin and direction (off)\n"
+		"  --lights N        add N small emissive spheres under a night sky (0)\n"
+		"  --nee on|off      sample emissive spheres at diffuse vertices, MIS with BSDF sampling (on)\n"
+		"  --output PATH     output image, .ppm, .png or .pfm (render.ppm)\n"
+		"  --checkpoint PATH accumulate into a memory-mapped file, resumed if it exists\n"
+		"  --checkpoint-interval S  seconds between checkpoint flushes (60)\n"
+		"  --exit-after-tiles N     testing: exit without cleanup after N tiles, like a killed render\n"
+		"  --quiet           no progress output\n"
+		"  --heatmap NAME    tests | nodes | bounces, writes the per sample cost as a heatmap,\n"
+		"                    megakernel and single rays only\n"
+		"  --heat-scale N    cost drawn as white, 0 for the most expensive pixel (0)\n"
+		"  --trace PATH      record frame, tile and scheduling spans as Chrome trace JSON\n"
+		"distributed rendering (fixed sample count, no adaptive sampling):\n"
+		"  --coordinator PORT   hand out jobs to workers on PORT, 0 picks a free port\n"
+		"  --local-workers N    spawn N worker processes of this executable (0)\n"
+		"  --worker HOST:PORT   render jobs for the coordinator at HOST:PORT\n"
+		"  --job-tile N         job tile size in pixels (64)\n"
+		"  --job-samples N      samples per pixel per job (16)\n"
+		"  --worker-timeout S   give up after S seconds without workers (30)\n"
+		"  --job-timeout S      drop a worker still on one job after S seconds (120)\n", program);
+}
+
+static int RunCoordinator(const char* executable, uint16_t port, size_t localWorkers, size_t threadsPerWorker, uint16_t width, uint16_t height, uint32_t samples,
+	SamplerType sampler, AccelerationStructure accel, uint32_t jobTile, uint32_t jobSamples, float workerTimeout, float jobTimeout, const char* output, bool quiet)
+{
+	// the coordinator only needs the scene identity and settings, it never traces
+	RaytracingInAWeekend reference;
+	reference.SetThreadCount(1);
+	reference.SetSampler(sampler);
+	reference.SetAccelerationStructure(accel);
+
+	Coordinator coordinator(reference, width, height, samples, jobTile, jobSamples);
+	if (!coordinator.Listen(port))
+	{
+		fprintf(stderr, "could not listen on port %u\n", static_cast<unsigned>(port));
+		return EXIT_FAILURE;
+	}
+	printf("coordinator listening on port %u, %zu jobs\n", static_cast<unsigned>(coordinator.Port()), coordinator.JobCount());
+
+	LocalWorkers workers;
+	if (localWorkers > 0 && !workers.Spawn(executable, coordinator.Port(), localWorkers, threadsPerWorker))
+	{
+		fprintf(stderr, "could not start local workers\n");
+		return EXIT_FAILURE;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	const bool finished = coordinator.Run(workerTimeout, jobTimeout, !quiet);
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	workers.Wait(5.0f);
+	if (!finished)
+	{
+		return EXIT_FAILURE;
+	}
+
+	const double rays = static_cast<double>(coordinator.RaysTraced());
+	const double paths = static_cast<double>(coordinator.PathsTraced());
+	printf("%ux%u, %u samples per pixel in %.3f s, %zu jobs reassigned\n", width, height, samples, elapsed, coordinator.ReassignedJobs());
+	printf("%.0f paths, %.0f rays, %.3f Msamples/s, %.3f Mrays/s\n", paths, rays, paths / elapsed * 1e-6, rays / elapsed * 1e-6);
+
+	if (!coordinator.WriteImage(output))
+	{
+		fprintf(stderr, "could not write %s\n", output);
+		return EXIT_FAILURE;
+	}
+	printf("wrote %s\n", output);
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+	uint16_t width = 1280;
+	uint16_t height = 768;
+	uint32_t samples = 64;
+	float seconds = 0.0f;
+	size_t threads = 0;
+	size_t tileSize = 16;
+	float threshold = 0.01f;
+	SamplerType sampler = SamplerType::SOBOL;
+	AccelerationStructure accel = AccelerationStructure::BVH8;
+	Integrator integrator = Integrator::MEGAKERNEL;
+	bool packets = false;
+	bool reorder = false;
+	bool lightSampling = true;
+	uint32_t lights = 0;
+	const char* output = "render.ppm";
+	const char* checkpoint = nullptr;
+	float checkpointInterval = 60.0f;
+	size_t exitAfterTiles = 0;
+	bool quiet = false;
+	int coordinatorPort = -1;
+	size_t localWorkers = 0;
+	const char* workerAddress = nullptr;
+	uint32_t jobTile = 64;
+	uint32_t jobSamples = 16;
+	float workerTimeout = 30.0f;
+	float jobTimeout = 120.0f;
+	DebugView debugView = DebugView::NONE;
+	float heatScale = 0.0f;
+	const char* tracePath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* option = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		const auto takesValue = [&]() -> bool
+			{
+				if (!value)
+				{
+					fprintf(stderr, "missing value for %s\n", option);
+					exit(EXIT_FAILURE);
+				}
+				++i;
+				return true;
+			};
+
+		if (!strcmp(option, "--width") && takesValue()) width = static_cast<uint16_t>(atoi(value));
+		else if (!strcmp(option, "--height") && takesValue()) height = static_cast<uint16_t>(atoi(value));
+		else if (!strcmp(option, "--samples") && takesValue()) samples = static_cast<uint32_t>(atoi(value));
+		else if (!strcmp(option, "--seconds") && takesValue()) seconds = static_cast<float>(atof(value));
+		else if (!strcmp(option, "--threads") && takesValue()) threads = static_cast<size_t>(atoi(value));
+		else if (!strcmp(option, "--tile") && takesValue()) tileSize = static_cast<size_t>(atoi(value));
+		else if (!strcmp(option, "--threshold") && takesValue()) threshold = static_cast<float>(atof(value));
+		else if (!strcmp(option, "--output") && takesValue()) output = value;
+		else if (!strcmp(option, "--checkpoint") && takesValue()) checkpoint = value;
+		else if (!strcmp(option, "--checkpoint-interval") && takesValue()) checkpointInterval = static_cast<float>(atof(value));
+		else if (!strcmp(option, "--exit-after-tiles") && takesValue()) exitAfterTiles = static_cast<size_t>(atoi(value));
+		else if (!strcmp(option, "--quiet")) quiet = true;
+		else if (!strcmp(option, "--coordinator") && takesValue()) coordinatorPort = atoi(value);
+		else if (!strcmp(option, "--local-workers") && takesValue()) localWorkers = static_cast<size_t>(atoi(value));
+		else if (!strcmp(option, "--worker") && takesValue()) workerAddress = value;
+		else if (!strcmp(option, "--job-tile") && takesValue()) jobTile = static_cast<uint32_t>(atoi(value));
+		else if (!strcmp(option, "--job-samples") && takesValue()) jobSamples = static_cast<uint32_t>(atoi(value));
+		else if (!strcmp(option, "--worker-timeout") && takesValue()) workerTimeout = static_cast<float>(atof(value));
+		else if (!strcmp(option, "--job-timeout") && takesValue()) jobTimeout = static_cast<float>(atof(value));
+		else if (!strcmp(option, "--trace") && takesValue()) tracePath = value;
+		else if (!strcmp(option, "--lights") && takesValue()) lights = static_cast<uint32_t>(atoi(value));
+		else if (!strcmp(option, "--heat-scale") && takesValue()) heatScale = static_cast<float>(atof(value));
+		else if (!strcmp(option, "--heatmap") && takesValue())
+		{
+			if (!strcmp(value, "tests")) debugView = DebugView::PRIMITIVE_TESTS;
+			else if (!strcmp(value, "nodes")) debugView = DebugView::BVH_NODES;
+			else if (!strcmp(value, "bounces")) debugView = DebugView::PATH_LENGTH;
+			else { fprintf(stderr, "unknown heatmap %s\n", value); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--sampler") && takesValue())
+		{
+			if (!strcmp(value, "independent")) sampler = SamplerType::INDEPENDENT;
+			else if (!strcmp(value, "sobol")) sampler = SamplerType::SOBOL;
+			else if (!strcmp(value, "rank1")) sampler = SamplerType::RANK1_BLUE_NOISE;
+			else { fprintf(stderr, "unknown sampler %s\n", value); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--integrator") && takesValue())
+		{
+			if (!strcmp(value, "megakernel")) integrator = Integrator::MEGAKERNEL;
+			else if (!strcmp(value, "wavefront")) integrator = Integrator::WAVEFRONT;
+			else { fprintf(stderr, "unknown integrator %s\n", value); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--packets") && takesValue())
+		{
+			if (!strcmp(value, "on")) packets = true;
+			else if (!strcmp(value, "off")) packets = false;
+			else { fprintf(stderr, "--packets expects on or off\n"); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--reorder") && takesValue())
+		{
+			if (!strcmp(value, "on")) reorder = true;
+			else if (!strcmp(value, "off")) reorder = false;
+			else { fprintf(stderr, "--reorder expects on or off\n"); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--nee") && takesValue())
+		{
+			if (!strcmp(value, "on")) lightSampling = true;
+			else if (!strcmp(value, "off")) lightSampling = false;
+			else { fprintf(stderr, "--nee expects on or off\n"); return EXIT_FAILURE; }
+		}
+		else if (!strcmp(option, "--accel") && takesValue())
+		{
+			if (!strcmp(value, "linear")) accel = AccelerationStructure::LINEAR;
+			else if (!strcmp(value, "bvh2")) accel = AccelerationStructure::BVH2;
+			else if (!strcmp(value, "bvh4")) accel = AccelerationStructure::BVH4;
+			else if (!strcmp(value, "bvh8")) accel = AccelerationStructure::BVH8;
+			else { fprintf(stderr, "unknown acceleration structure %s\n", value); return EXIT_FAILURE; }
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return !strcmp(option, "--help") ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	// heat sums are neither checkpointed nor sent back by workers
+	if (debugView != DebugView::NONE && (checkpoint || workerAddress || coordinatorPort >= 0))
+	{
+		fprintf(stderr, "--heatmap renders locally and without a checkpoint\n");
+		return EXIT_FAILURE;
+	}
+
+	// only the megakernel counts per path, the heatmap would silently measure it instead
+	if (debugView != DebugView::NONE && (integrator != Integrator::MEGAKERNEL || packets))
+	{
+		fprintf(stderr, "--heatmap measures the megakernel with single rays, not --integrator wavefront or --packets on\n");
+		return EXIT_FAILURE;
+	}
+
+	// workers build the default scene
+	if (lights > 0 && (workerAddress || coordinatorPort >= 0))
+	{
+		fprintf(stderr, "--lights renders locally\n");
+		return EXIT_FAILURE;
+	}
+
+	if (workerAddress)
+	{
+		const char* colon = strrchr(workerAddress, ':');
+		if (!colon)
+		{
+			fprintf(stderr, "--worker expects HOST:PORT\n");
+			return EXIT_FAILURE;
+		}
+		const std::string host(workerAddress, colon);
+		return DISTRIBUTED::RunWorker(host.c_str(), static_cast<uint16_t>(atoi(colon + 1)), threads, !quiet);
+	}
+
+	if (coordinatorPort >= 0)
+	{
+		if (width < 2 || height < 2 || samples == 0)
+		{
+			fprintf(stderr, "distributed renders need a resolution of at least 2x2 and a sample count\n");
+			return EXIT_FAILURE;
+		}
+		return RunCoordinator(argv[0], static_cast<uint16_t>(coordinatorPort), localWorkers, threads, width, height, samples, sampler, accel, jobTile, jobSamples, workerTimeout, jobTimeout, output, quiet);
+	}
+
+	if (width < 2 || height < 2 || (samples == 0 && seconds <= 0.0f))
+	{
+		fprintf(stderr, "need a resolution of at least 2x2 and a sample or time budget\n");
+		return EXIT_FAILURE;
+	}
+
+	RaytracingInAWeekend raytracer;
+	raytracer.SetThreadCount(threads);
+	raytracer.SetTileSize(tileSize);
+	raytracer.SetSampler(sampler);
+	raytracer.SetAdaptiveSampling(threshold);
+	raytracer.SetAccelerationStructure(accel);
+	raytracer.SetIntegrator(integrator);
+	raytracer.SetPacketTracing(packets);
+	raytracer.SetRayReordering(reorder);
+	raytracer.SetLightSampling(lightSampling);
+	if (lights > 0)
+	{
+		raytracer.LoadScene(0, 1, lights);
+	}
+	raytracer.SetRenderBudget(samples, seconds);
+	raytracer.SetStreamingOutput(output);
+	if (!raytracer.SetDebugView(debugView, heatScale))
+	{
+		fprintf(stderr, "the %s heatmap needs a debug build or -DRT_STATS=ON\n", DebugViewName(debugView));
+		return EXIT_FAILURE;
+	}
+	if (checkpoint)
+	{
+		raytracer.SetCheckpoint(checkpoint, checkpointInterval);
+	}
+	raytracer.SetExitAfterTiles(exitAfterTiles);
+	if (tracePath)
+	{
+		PROFILER::Enable();
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	const RESULT_VALUE result = raytracer.Start(std::make_unique<Platform::HeadlessBackend>(!quiet), width, height);
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (result == RESULT_VALUE::CHECKPOINT_MISMATCH)
+	{
+		fprintf(stderr, "%s belongs to another scene, resolution or settings\n", checkpoint);
+		return EXIT_FAILURE;
+	}
+	if (result != RESULT_VALUE::OK)
+	{
+		fprintf(stderr, "render failed\n");
+		return EXIT_FAILURE;
+	}
+	if (raytracer.ResumedFromCheckpoint())
+	{
+		printf("resumed from %s\n", checkpoint);
+	}
+
+	const double rays = static_cast<double>(raytracer.RaysTraced());
+	const double paths = static_cast<double>(raytracer.PathsTraced());
+	printf("%ux%u, %zu samples per pixel in %.3f s, %u threads\n", width, height, raytracer.SamplesTaken(), elapsed, static_cast<unsigned>(raytracer.GetThreadPool().ThreadCount()));
+	printf("%.0f paths, %.0f rays, %.3f Msamples/s, %.3f Mrays/s\n", paths, rays, paths / elapsed * 1e-6, rays / elapsed * 1e-6);
+	if constexpr (STATS::ENABLED)
+	{
+		printf("%s\n", raytracer.TotalCounters().Summary().c_str());
+	}
+	if (debugView != DebugView::NONE)
+	{
+		printf("heatmap of %s per sample, black 0 to white %.1f\n", DebugViewName(debugView), raytracer.HeatmapScale());
+	}
+
+	if (!raytracer.FinishStreamingOutput())
+	{
+		fprintf(stderr, "could not write %s\n", output);
+		return EXIT_FAILURE;
+	}
+	printf("wrote %s\n", output);
+
+	// the render thread and the pool are idle once Start() returned
+	if (tracePath)
+	{
+		if (!PROFILER::WriteChromeTrace(tracePath))
+		{
+			fprintf(stderr, "could not write %s\n", tracePath);
+			return EXIT_FAILURE;
+		}
+		printf("wrote %s\n", tracePath);
+	}
+	return EXIT_SUCCESS;
+}
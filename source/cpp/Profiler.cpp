@@ -0,0 +1,121 @@
+#include "../Profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<PROFILER::ThreadTrace>> traces;
+		size_t capacity = 1 << 16;
+	};
+
+	// leaked on purpose, pool threads may still record while static destructors run
+	Registry& GetRegistry()
+	{
+		static Registry* registry = new Registry();
+		return *registry;
+	}
+
+	thread_local std::string t_name;
+};
+
+PROFILER::ThreadTrace::ThreadTrace(uint32_t id, size_t capacity)
+	: m_id(id)
+{
+	size_t size = 1;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+	m_events = std::make_unique<Event[]>(size);
+	m_mask = size - 1;
+}
+
+void PROFILER::Enable(size_t eventsPerThread)
+{
+	{
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.capacity = std::max<size_t>(eventsPerThread, 1);
+	}
+	s_enabled.store(true);
+}
+
+void PROFILER::Disable() noexcept
+{
+	s_enabled.store(false);
+}
+
+PROFILER::ThreadTrace& PROFILER::RegisterThread()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.traces.push_back(std::make_unique<ThreadTrace>(static_cast<uint32_t>(registry.traces.size()), registry.capacity));
+	t_trace = registry.traces.back().get();
+	t_trace->name = t_name.empty() ? "thread " + std::to_string(t_trace->Id()) : t_name;
+	return *t_trace;
+}
+
+void PROFILER::SetThreadName(const char* name)
+{
+	t_name = name;
+	if (t_trace)
+	{
+		std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+		t_trace->name = t_name;
+	}
+}
+
+bool PROFILER::WriteChromeTrace(const char* path)
+{
+	FILE* out = fopen(path, "w");
+	if (!out)
+	{
+		return false;
+	}
+
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	uint64_t origin = UINT64_MAX;
+	for (const std::unique_ptr<ThreadTrace>& trace : registry.traces)
+	{
+		trace->ForEach([&](const Event& event) { origin = std::min(origin, event.begin); });
+	}
+
+	fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	fprintf(out, "{\"ph\": \"M\", \"pid\": 1, \"name\": \"process_name\", \"args\": {\"name\": \"raytracer\"}}");
+	for (const std::unique_ptr<ThreadTrace>& trace : registry.traces)
+	{
+		fprintf(out, ",\n{\"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"name\": \"thread_name\", \"args\": {\"name\": \"%s\"}}", trace->Id(), trace->name.c_str());
+		fprintf(out, ",\n{\"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"name\": \"thread_sort_index\", \"args\": {\"sort_index\": %u}}", trace->Id(), trace->Id());
+	}
+	for (const std::unique_ptr<ThreadTrace>& trace : registry.traces)
+	{
+		trace->ForEach([&](const Event& event)
+			{
+				fprintf(out, ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"name\": \"%s\", \"ts\": %.3f, \"dur\": %.3f", event.thread, event.name,
+					static_cast<double>(event.begin - origin) * 1e-3, static_cast<double>(event.end - event.begin) * 1e-3);
+				if (event.items || event.metric)
+				{
+					fprintf(out, ", \"args\": {");
+					if (event.items)
+					{
+						fprintf(out, "\"items\": %u%s", event.items, event.metric ? ", " : "");
+					}
+					if (event.metric)
+					{
+						fprintf(out, "\"%s\": %.4f", event.metric, event.value);
+					}
+					fprintf(out, "}");
+				}
+				fprintf(out, "}");
+			});
+	}
+	fprintf(out, "\n]}\n");
+	return fclose(out) == 0;
+}
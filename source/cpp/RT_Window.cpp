@@ -1,8 +1,10 @@
 #include "../RT_Window.h"
 
+#ifdef _WIN32
+
 namespace Platform
 {
-	Window::Window(uint16_t width, uint16_t height, std::wstring_view windowName) : m_Height(height), m_Width(width)
+	Window::Window(uint16_t width, uint16_t height, std::wstring_view windowName) : m_Width(width), m_Height(height)
 	{
 		WNDCLASSEX wc = { };
 
@@ -15,6 +17,7 @@ namespace Platform
 
         m_hwnd = CreateWindowExW(0, L"RTWindowProgram", windowName.data(), WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, width, height, nullptr, nullptr, this->m_hInstance, nullptr);
 
+        SetWindowLongPtrW(m_hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
         ShowWindow(m_hwnd, SW_SHOWNORMAL);
 
 		m_hdc = GetDC(m_hwnd);
@@ -39,7 +42,77 @@ namespace Platform
 				PostQuitMessage(0);
 				return 0;
 			}
+			// posted by Win32Backend::Quit, a modal loop that receives the WM_QUIT passes it on to Run()
+			case WM_RT_QUIT:
+			{
+				PostQuitMessage(0);
+				return 0;
+			}
+			case WM_RT_NOTIFY:
+			{
+				const Window* window = reinterpret_cast<const Window*>(GetWindowLongPtrW(hWND, GWLP_USERDATA));
+				if (window && window->m_onNotify)
+				{
+					(*window->m_onNotify)();
+				}
+				return 0;
+			}
 		}
 		return DefWindowProc(hWND, Msg, wParam, lParam);
 	}
+
+	Win32Backend::Win32Backend(uint16_t width, uint16_t height, std::wstring_view windowName) : m_window(width, height, windowName)
+	{
+	}
+
+	Win32Backend::~Win32Backend()
+	{
+		if (m_window.m_hwnd && m_window.m_hdc)
+		{
+			ReleaseDC(m_window.m_hwnd, m_window.m_hdc);
+		}
+	}
+
+	void Win32Backend::Run(const std::function<void()>& onNotify)
+	{
+		m_window.m_onNotify = &onNotify;
+		MSG msg = {};
+		while (GetMessageW(&msg, nullptr, 0, 0) > 0)
+		{
+			TranslateMessage(&msg);
+			DispatchMessageW(&msg);
+		}
+		m_window.m_onNotify = nullptr;
+	}
+
+	void Win32Backend::Notify() noexcept
+	{
+		PostMessageW(m_window.m_hwnd, Window::WM_RT_NOTIFY, 0, 0);
+	}
+
+	void Win32Backend::Quit() noexcept
+	{
+		PostMessageW(m_window.m_hwnd, Window::WM_RT_QUIT, 0, 0);
+	}
+
+	void Win32Backend::Present(const uint8_t* bgr, uint16_t width, uint16_t height) noexcept
+	{
+		BITMAPINFO bmi = {};
+		bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+		bmi.bmiHeader.biWidth = width;
+		bmi.bmiHeader.biHeight = -static_cast<LONG>(height);
+		bmi.bmiHeader.biPlanes = 1;
+		bmi.bmiHeader.biBitCount = 24;
+		bmi.bmiHeader.biCompression = BI_RGB;
+
+		SetDIBitsToDevice(m_window.m_hdc, 0, 0, width, height, 0, 0, 0, height, bgr, &bmi, DIB_RGB_COLORS);
+	}
+
+	void Win32Backend::SetTitle(std::wstring_view title) noexcept
+	{
+		const std::wstring terminated(title);
+		SetWindowTextW(m_window.m_hwnd, terminated.c_str());
+	}
 };
+
+#endif
@@ -0,0 +1,106 @@
+#include "../Scene.h"
+#include "../Checkpoint.h"
+
+void Scene::Build()
+{
+	const uint32_t sphereCount = static_cast<uint32_t>(m_spheres.Size());
+	const uint32_t customCount = static_cast<uint32_t>(m_custom.size());
+
+	// primitive i < sphereCount is a sphere, the rest are custom objects
+	std::vector<AABB> bounds;
+	bounds.reserve(static_cast<size_t>(sphereCount) + customCount);
+	for (uint32_t i = 0; i < sphereCount; ++i)
+	{
+		bounds.push_back(m_spheres.BoundingBox(i));
+	}
+	for (uint32_t i = 0; i < customCount; ++i)
+	{
+		bounds.push_back(m_custom[i]->BoundingBox());
+	}
+
+	m_bvh.Build(bounds);
+
+	const std::vector<uint32_t>& order = m_bvh.PrimitiveIndices();
+	std::vector<uint32_t> sphereOrder;
+	std::vector<std::unique_ptr<Hittable>> customSorted;
+	sphereOrder.reserve(sphereCount);
+	customSorted.reserve(customCount);
+
+	m_sphereOffset.assign(order.size() + 1, 0);
+	m_customOffset.assign(order.size() + 1, 0);
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const PrimitiveType type = order[i] < sphereCount ? PrimitiveType::SPHERE : PrimitiveType::CUSTOM;
+		switch (type)
+		{
+			case PrimitiveType::SPHERE:
+				sphereOrder.push_back(order[i]);
+				break;
+			case PrimitiveType::CUSTOM:
+				customSorted.push_back(std::move(m_custom[order[i] - sphereCount]));
+				break;
+		}
+		m_sphereOffset[i + 1] = static_cast<uint32_t>(sphereOrder.size());
+		m_customOffset[i + 1] = static_cast<uint32_t>(customSorted.size());
+	}
+
+	m_spheres.Reorder(sphereOrder);
+	m_custom = std::move(customSorted);
+
+	m_lights.clear();
+	for (uint32_t i = 0; i < sphereCount; ++i)
+	{
+		if (m_materials[m_spheres.GetMaterialID(i)].type == MaterialType::EMISSIVE)
+		{
+			m_lights.push_back(i);
+		}
+	}
+
+	m_bvh4.Build(m_bvh);
+#ifdef WIDE_BVH_HAS_8
+	m_bvh8.Build(m_bvh);
+#endif
+}
+
+uint64_t Scene::Hash() const noexcept
+{
+	uint64_t hash = HashValue(m_spheres.Size(), 0xCBF29CE484222325ull);
+	for (size_t i = 0; i < m_spheres.Size(); ++i)
+	{
+		const Vec3f center = m_spheres.Center(i);
+		hash = HashValue(center.x, hash);
+		hash = HashValue(center.y, hash);
+		hash = HashValue(center.z, hash);
+		hash = HashValue(m_spheres.Radius(i), hash);
+		hash = HashValue(m_spheres.GetMaterialID(i), hash);
+	}
+
+	hash = HashValue(m_custom.size(), hash);
+	for (const auto& object : m_custom)
+	{
+		const AABB bounds = object->BoundingBox();
+		hash = HashBytes(bounds.min.e, sizeof(bounds.min.e), hash);
+		hash = HashBytes(bounds.max.e, sizeof(bounds.max.e), hash);
+		hash = HashValue(object->materialID, hash);
+	}
+
+	hash = HashValue(m_materials.size(), hash);
+	for (const Material& material : m_materials)
+	{
+		hash = HashBytes(material.Albedo.e, sizeof(material.Albedo.e), hash);
+		hash = HashValue(material.ScatterChance, hash);
+		hash = HashValue(material.Fuzz, hash);
+		hash = HashValue(material.RefractionIndex, hash);
+		hash = HashValue(material.type, hash);
+		if (material.type == MaterialType::EMISSIVE)
+		{
+			hash = HashBytes(material.Emission.e, sizeof(material.Emission.e), hash);
+		}
+	}
+	// only a changed sky enters the hash, so default scenes keep theirs
+	if (m_skyIntensity != 1.0f)
+	{
+		hash = HashValue(m_skyIntensity, hash);
+	}
+	return hash;
+}
@@ -0,0 +1,203 @@
+#include "../Socket.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+using PollDescriptor = WSAPOLLFD;
+static int PollSockets(PollDescriptor* descriptors, size_t count, int timeoutMs) { return WSAPoll(descriptors, static_cast<ULONG>(count), timeoutMs); }
+static void CloseSocket(SocketHandle handle) { closesocket(handle); }
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+using PollDescriptor = pollfd;
+static int PollSockets(PollDescriptor* descriptors, size_t count, int timeoutMs) { return poll(descriptors, static_cast<nfds_t>(count), timeoutMs); }
+static void CloseSocket(SocketHandle handle) { close(handle); }
+#endif
+
+bool Socket::Initialize() noexcept
+{
+#ifdef _WIN32
+	WSADATA data = {};
+	return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+	return true;
+#endif
+}
+
+bool Socket::Listen(uint16_t port, int backlog) noexcept
+{
+	Close();
+
+	const SocketHandle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (handle == INVALID)
+	{
+		return false;
+	}
+	m_handle = handle;
+
+	const int enable = 1;
+	setsockopt(m_handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enable), sizeof(enable));
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind(m_handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(m_handle, backlog) != 0)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+Socket Socket::Accept() noexcept
+{
+	const SocketHandle handle = accept(m_handle, nullptr, nullptr);
+	if (handle == INVALID)
+	{
+		return Socket();
+	}
+
+	// results are sent as one large write, the small control messages should not wait for Nagle
+	const int enable = 1;
+	setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+	return Socket(handle);
+}
+
+bool Socket::Connect(const char* host, uint16_t port) noexcept
+{
+	Close();
+
+	char service[8];
+	snprintf(service, sizeof(service), "%u", static_cast<unsigned>(port));
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addresses = nullptr;
+	if (getaddrinfo(host, service, &hints, &addresses) != 0)
+	{
+		return false;
+	}
+
+	for (const addrinfo* candidate = addresses; candidate; candidate = candidate->ai_next)
+	{
+		const SocketHandle handle = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+		if (handle == INVALID)
+		{
+			continue;
+		}
+		if (connect(handle, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) == 0)
+		{
+			const int enable = 1;
+			setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+			m_handle = handle;
+			break;
+		}
+		CloseSocket(handle);
+	}
+	freeaddrinfo(addresses);
+	return IsValid();
+}
+
+bool Socket::SendAll(const void* data, size_t size) noexcept
+{
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0)
+	{
+		const int chunk = static_cast<int>(size > (1u << 30) ? (1u << 30) : size);
+#ifdef MSG_NOSIGNAL
+		const auto sent = send(m_handle, bytes, chunk, MSG_NOSIGNAL);
+#else
+		const auto sent = send(m_handle, bytes, chunk, 0);
+#endif
+		if (sent <= 0)
+		{
+			return false;
+		}
+		bytes += sent;
+		size -= static_cast<size_t>(sent);
+	}
+	return true;
+}
+
+bool Socket::ReceiveAll(void* data, size_t size) noexcept
+{
+	char* bytes = static_cast<char*>(data);
+	while (size > 0)
+	{
+		const int chunk = static_cast<int>(size > (1u << 30) ? (1u << 30) : size);
+		const auto received = recv(m_handle, bytes, chunk, 0);
+		if (received <= 0)
+		{
+			return false;
+		}
+		bytes += received;
+		size -= static_cast<size_t>(received);
+	}
+	return true;
+}
+
+bool Socket::SetReceiveTimeout(int timeoutMs) noexcept
+{
+#ifdef _WIN32
+	const DWORD timeout = static_cast<DWORD>(timeoutMs);
+#else
+	timeval timeout = {};
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_usec = (timeoutMs % 1000) * 1000;
+#endif
+	return setsockopt(m_handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout)) == 0;
+}
+
+void Socket::Close() noexcept
+{
+	if (IsValid())
+	{
+		CloseSocket(m_handle);
+		m_handle = INVALID;
+	}
+}
+
+uint16_t Socket::LocalPort() const noexcept
+{
+	sockaddr_in address = {};
+	socklen_t length = sizeof(address);
+	if (getsockname(m_handle, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+	{
+		return 0;
+	}
+	return ntohs(address.sin_port);
+}
+
+int Socket::WaitReadable(const std::vector<const Socket*>& sockets, std::vector<uint8_t>& ready, int timeoutMs) noexcept
+{
+	std::vector<PollDescriptor> descriptors(sockets.size());
+	for (size_t i = 0; i < sockets.size(); ++i)
+	{
+		descriptors[i].fd = sockets[i]->m_handle;
+		descriptors[i].events = POLLIN;
+	}
+
+	const int result = PollSockets(descriptors.data(), descriptors.size(), timeoutMs);
+	ready.assign(sockets.size(), 0);
+	for (size_t i = 0; result > 0 && i < sockets.size(); ++i)
+	{
+		ready[i] = (descriptors[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+	}
+	return result;
+}
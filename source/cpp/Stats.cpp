@@ -0,0 +1,120 @@
+#include "../Stats.h"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	// own cache lines, so threads counting side by side never share one
+	struct alignas(64) ThreadBlock
+	{
+		STATS::Snapshot snapshot;
+	};
+
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadBlock>> blocks;
+	};
+
+	// leaked on purpose, pool threads may still count while static destructors run
+	Registry& GetRegistry()
+	{
+		static Registry* registry = new Registry();
+		return *registry;
+	}
+
+	double Ratio(uint64_t a, uint64_t b) noexcept
+	{
+		return b ? static_cast<double>(a) / static_cast<double>(b) : 0.0;
+	}
+};
+
+uint64_t STATS::Snapshot::Paths() const noexcept
+{
+	uint64_t paths = 0;
+	for (uint64_t count : pathLengths)
+	{
+		paths += count;
+	}
+	return paths;
+}
+
+double STATS::Snapshot::MeanBounces() const noexcept
+{
+	uint64_t bounces = 0;
+	for (uint32_t i = 0; i < PATH_LENGTH_BUCKETS; ++i)
+	{
+		bounces += i * pathLengths[i];
+	}
+	return Ratio(bounces, Paths());
+}
+
+std::string STATS::Snapshot::Summary() const
+{
+	const uint64_t scatters = counters[SCATTER_LAMBERTIAN] + counters[SCATTER_METALLIC] + counters[SCATTER_DIELECTRIC];
+	char text[256];
+	snprintf(text, sizeof(text), "%.2f bounces/path, %.1f nodes/ray, %.1f tests/ray, RR %.1f%%, L/M/D %.0f/%.0f/%.0f%%",
+		MeanBounces(), Ratio(counters[BVH_NODES], Rays()), Ratio(counters[PRIMITIVE_TESTS], Rays()), 100.0 * Ratio(counters[ROULETTE_KILLS], Paths()),
+		100.0 * Ratio(counters[SCATTER_LAMBERTIAN], scatters), 100.0 * Ratio(counters[SCATTER_METALLIC], scatters), 100.0 * Ratio(counters[SCATTER_DIELECTRIC], scatters));
+	std::string summary = text;
+	if (counters[SHADOW_RAYS])
+	{
+		snprintf(text, sizeof(text), ", %.2f shadow rays/path", Ratio(counters[SHADOW_RAYS], Paths()));
+		summary += text;
+	}
+	if (counters[REORDERED_RAYS])
+	{
+		snprintf(text, sizeof(text), ", %.1f rays/bin", Ratio(counters[REORDERED_RAYS], counters[REORDER_BINS]));
+		summary += text;
+	}
+	return summary;
+}
+
+std::string STATS::Snapshot::Json(const char* indent) const
+{
+	std::string json = "{\n";
+	char line[160];
+	for (uint32_t i = 0; i < COUNTER_COUNT; ++i)
+	{
+		snprintf(line, sizeof(line), "%s  \"%s\": %llu,\n", indent, COUNTER_NAMES[i], static_cast<unsigned long long>(counters[i]));
+		json += line;
+	}
+	snprintf(line, sizeof(line), "%s  \"nodes_per_ray\": %.4f, \"tests_per_ray\": %.4f, \"bounces_per_path\": %.4f, \"rays_per_bin\": %.4f,\n", indent,
+		Ratio(counters[BVH_NODES], Rays()), Ratio(counters[PRIMITIVE_TESTS], Rays()), MeanBounces(), Ratio(counters[REORDERED_RAYS], counters[REORDER_BINS]));
+	json += line;
+
+	json += indent;
+	json += "  \"path_lengths\": [";
+	for (uint32_t i = 0; i < PATH_LENGTH_BUCKETS; ++i)
+	{
+		snprintf(line, sizeof(line), "%s%llu", i ? ", " : "", static_cast<unsigned long long>(pathLengths[i]));
+		json += line;
+	}
+	json += "]\n";
+	json += indent;
+	json += "}";
+	return json;
+}
+
+STATS::Snapshot& STATS::RegisterThread()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.blocks.push_back(std::make_unique<ThreadBlock>());
+	t_local = &registry.blocks.back()->snapshot;
+	return *t_local;
+}
+
+STATS::Snapshot STATS::Collect()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	Snapshot total;
+	for (const std::unique_ptr<ThreadBlock>& block : registry.blocks)
+	{
+		total += block->snapshot;
+	}
+	return total;
+}
@@ -0,0 +1,246 @@
+#include "../ThreadPool.h"
+#include "../Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	m_workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		m_workers.push_back(std::make_unique<Worker>());
+	}
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		m_workers[i]->thread = std::thread(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers)
+	{
+		worker->thread.join();
+	}
+}
+
+void ThreadPool::Dispatch(size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	// a worker still looking for work from the last dispatch can steal the first
+	// tasks pushed below, so the count and its counters are set before any of them
+	m_remaining.store(count);
+	const size_t workerCount = m_workers.size();
+	for (size_t w = 0; w < workerCount; ++w)
+	{
+		std::lock_guard<std::mutex> lock(m_workers[w]->mutex);
+		m_workers[w]->dispatchTasks = 0;
+		m_workers[w]->busyNanoseconds = 0;
+	}
+
+	// contiguous blocks keep neighbouring tiles on the same worker until stealing kicks in
+	for (size_t w = 0; w < workerCount; ++w)
+	{
+		const size_t begin = count * w / workerCount;
+		const size_t end = count * (w + 1) / workerCount;
+
+		std::lock_guard<std::mutex> lock(m_workers[w]->mutex);
+		for (size_t i = begin; i < end; ++i)
+		{
+			m_workers[w]->tasks.push_back(i);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return m_remaining.load() == 0; });
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	m_wallSeconds += std::chrono::duration<double>(end - start).count();
+	if (PROFILER::Enabled())
+	{
+		RecordDispatch(count, PROFILER::Timestamp(start), PROFILER::Timestamp(end));
+	}
+}
+
+// The dispatch as one span on the calling thread, with the busiest worker's time over
+// the mean as its imbalance, and each worker's idle stretches, waking up late and
+// running dry before the last task finished, as spans on that worker's track. Task
+// timings are written before the task's m_remaining decrement, so they are visible here
+void ThreadPool::RecordDispatch(size_t count, uint64_t begin, uint64_t end) const
+{
+	uint64_t busiest = 0;
+	uint64_t busyTotal = 0;
+	PROFILER::ThreadTrace& trace = PROFILER::Local();
+	for (const std::unique_ptr<Worker>& worker : m_workers)
+	{
+		busiest = std::max(busiest, worker->busyNanoseconds);
+		busyTotal += worker->busyNanoseconds;
+
+		const uint32_t thread = worker->traceThread.load();
+		if (thread == UINT32_MAX)
+		{
+			continue;
+		}
+		if (worker->dispatchTasks == 0)
+		{
+			trace.Record({ "idle", begin, end, thread, 0, nullptr, 0.0 });
+			continue;
+		}
+		if (worker->firstTaskBegin > begin)
+		{
+			trace.Record({ "idle", begin, worker->firstTaskBegin, thread, 0, nullptr, 0.0 });
+		}
+		if (worker->lastTaskEnd < end)
+		{
+			trace.Record({ "idle", worker->lastTaskEnd, end, thread, 0, nullptr, 0.0 });
+		}
+	}
+
+	const double meanBusy = static_cast<double>(busyTotal) / static_cast<double>(m_workers.size());
+	trace.Record({ "ParallelFor", begin, end, trace.Id(), static_cast<uint32_t>(count), "imbalance", meanBusy > 0.0 ? static_cast<double>(busiest) / meanBusy : 1.0 });
+}
+
+void ThreadPool::WorkerLoop(size_t workerIndex)
+{
+	Worker& self = *m_workers[workerIndex];
+	uint64_t seenGeneration = 0;
+	PROFILER::SetThreadName(("worker " + std::to_string(workerIndex)).c_str());
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_stop || m_generation != seenGeneration; });
+			if (m_stop)
+			{
+				return;
+			}
+			seenGeneration = m_generation;
+		}
+
+		const bool profiling = PROFILER::Enabled();
+		if (profiling)
+		{
+			self.traceThread.store(PROFILER::Local().Id());
+		}
+
+		size_t task = 0;
+		while (PopLocal(workerIndex, task) || Steal(workerIndex, task))
+		{
+			const auto start = std::chrono::steady_clock::now();
+			m_taskInvoke(m_taskContext, task);
+			const auto end = std::chrono::steady_clock::now();
+			self.stats.busySeconds += std::chrono::duration<double>(end - start).count();
+			self.stats.tasks++;
+
+			const uint64_t begin = PROFILER::Timestamp(start);
+			self.lastTaskEnd = PROFILER::Timestamp(end);
+			self.firstTaskBegin = self.dispatchTasks++ ? self.firstTaskBegin : begin;
+			self.busyNanoseconds += self.lastTaskEnd - begin;
+			if (profiling)
+			{
+				PROFILER::Local().Record({ m_spanName, begin, self.lastTaskEnd, PROFILER::Local().Id(), 0, nullptr, 0.0 });
+			}
+
+			if (m_remaining.fetch_sub(1) == 1)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_done.notify_all();
+			}
+		}
+	}
+}
+
+bool ThreadPool::PopLocal(size_t workerIndex, size_t& task) noexcept
+{
+	Worker& self = *m_workers[workerIndex];
+	std::lock_guard<std::mutex> lock(self.mutex);
+	if (self.tasks.empty())
+	{
+		return false;
+	}
+	task = self.tasks.front();
+	self.tasks.pop_front();
+	return true;
+}
+
+bool ThreadPool::Steal(size_t thiefIndex, size_t& task) noexcept
+{
+	const size_t workerCount = m_workers.size();
+	for (size_t offset = 1; offset < workerCount; ++offset)
+	{
+		Worker& victim = *m_workers[(thiefIndex + offset) % workerCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			m_workers[thiefIndex]->stats.steals++;
+			return true;
+		}
+	}
+	return false;
+}
+
+double ThreadPool::Utilization(size_t worker) const noexcept
+{
+	return m_wallSeconds > 0.0 ? m_workers[worker]->stats.busySeconds / m_wallSeconds : 0.0;
+}
+
+double ThreadPool::AverageUtilization() const noexcept
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < m_workers.size(); ++i)
+	{
+		sum += Utilization(i);
+	}
+	return sum / m_workers.size();
+}
+
+std::string ThreadPool::UtilizationReport() const
+{
+	std::string report;
+	char line[128];
+	for (size_t i = 0; i < m_workers.size(); ++i)
+	{
+		const WorkerStats& stats = m_workers[i]->stats;
+		snprintf(line, sizeof(line), "worker %zu: %5.1f%% busy, %llu tasks, %llu stolen\n", i, 100.0 * Utilization(i),
+			static_cast<unsigned long long>(stats.tasks), static_cast<unsigned long long>(stats.steals));
+		report += line;
+	}
+	return report;
+}
+
+void ThreadPool::ResetStats() noexcept
+{
+	for (auto& worker : m_workers)
+	{
+		worker->stats = WorkerStats();
+	}
+	m_wallSeconds = 0.0;
+}
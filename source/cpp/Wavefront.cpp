@@ -0,0 +1,270 @@
+#include "../Wavefront.h"
+#include "../Profiler.h"
+#include <algorithm>
+
+namespace
+{
+	// 10 bit value to every third bit of 30
+	uint32_t SpreadBits(uint32_t v) noexcept
+	{
+		v = (v | (v << 16)) & 0x030000FFu;
+		v = (v | (v << 8)) & 0x0300F00Fu;
+		v = (v | (v << 4)) & 0x030C30C3u;
+		v = (v | (v << 2)) & 0x09249249u;
+		return v;
+	}
+
+	uint32_t Morton(uint32_t x, uint32_t y, uint32_t z) noexcept
+	{
+		return SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+	}
+
+	uint32_t Quantize(float value, float low, float scale, uint32_t maximum) noexcept
+	{
+		const float cell = (value - low) * scale;
+		return cell <= 0.0f ? 0 : std::min(static_cast<uint32_t>(cell), maximum);
+	}
+
+	// sort key layout, low to high: 9 bit direction Morton code (3 bits per axis),
+	// 30 bit origin Morton code (10 bits per axis), 3 bit direction octant
+	constexpr uint32_t DIRECTION_BITS = 9;
+	constexpr uint32_t ORIGIN_BITS = 30;
+
+	// what the bin counter calls one bin: the octant and the top 3 bits of each origin axis
+	constexpr uint32_t BIN_SHIFT = DIRECTION_BITS + ORIGIN_BITS - 9;
+};
+
+uint64_t Wavefront::Trace(const Scene& scene, const Settings& settings) noexcept
+{
+	m_extension.resize(m_paths.size());
+	for (size_t i = 0; i < m_paths.size(); ++i)
+	{
+		m_extension[i] = static_cast<uint32_t>(i);
+	}
+
+	uint64_t rays = 0;
+	for (int depth = 0; !m_extension.empty(); ++depth)
+	{
+		rays += m_extension.size();
+		if (settings.reorderSecondary && depth > 0)
+		{
+			Reorder();
+		}
+		Intersect(scene, depth, settings.maxDepth, depth == 0 && settings.primaryPackets);
+		ShadeEscaped(scene, depth);
+		ShadeEmissive(scene, depth);
+
+		m_nextExtension.clear();
+		m_shadowRays.clear();
+		Shade<MaterialType::LAMBERTIAN>(scene, depth, settings);
+		Shade<MaterialType::METALLIC>(scene, depth, settings);
+		Shade<MaterialType::DIELECTRIC>(scene, depth, settings);
+		rays += m_shadowRays.size();
+		TraceShadows(scene);
+		std::swap(m_extension, m_nextExtension);
+	}
+	return rays;
+}
+
+// Paths at the maximum depth end here, like in RayColor they are only cut once
+// their last ray found a surface that is not an emitter
+void Wavefront::Intersect(const Scene& scene, int depth, int maxDepth, bool packets) noexcept
+{
+	if (packets)
+	{
+		IntersectPackets(scene);
+	}
+
+	m_escaped.clear();
+	for (std::vector<uint32_t>& queue : m_materialQueues)
+	{
+		queue.clear();
+	}
+
+	for (uint32_t index : m_extension)
+	{
+		Path& path = m_paths[index];
+		path.sampler.StartBounce(static_cast<uint32_t>(depth + 1));
+		RT_STAT_ADD(depth == 0 ? STATS::PRIMARY_RAYS : STATS::SECONDARY_RAYS, 1);
+
+		const bool hit = packets ? path.hit.t >= 0.0f : scene.ClosestHit(path.ray, 0.001f, 5000.1f, &(path.hit = HitRegistry()));
+		if (!hit)
+		{
+			m_escaped.push_back(index);
+		}
+		else if (scene.GetMaterial(path.hit.materialID).type == MaterialType::EMISSIVE)
+		{
+			m_materialQueues[static_cast<size_t>(MaterialType::EMISSIVE)].push_back(index);
+		}
+		else if (depth >= maxDepth)
+		{
+			RT_STAT_ADD(STATS::DEPTH_LIMITED, 1);
+			RT_STAT_PATH(depth);
+		}
+		else
+		{
+			m_materialQueues[static_cast<size_t>(scene.GetMaterial(path.hit.materialID).type)].push_back(index);
+		}
+	}
+}
+
+// Consecutive paths of the first extension are neighboring pixels of a tile row
+void Wavefront::IntersectPackets([[maybe_unused]] const Scene& scene) noexcept
+{
+#if RAY_PACKETS
+	Ray rays[RayPacket::SIZE];
+	HitRegistry hits[RayPacket::SIZE];
+	for (size_t first = 0; first < m_extension.size(); first += RayPacket::SIZE)
+	{
+		const uint32_t count = static_cast<uint32_t>(std::min<size_t>(RayPacket::SIZE, m_extension.size() - first));
+		for (uint32_t lane = 0; lane < count; ++lane)
+		{
+			rays[lane] = m_paths[m_extension[first + lane]].ray;
+		}
+		scene.ClosestHitPacket(rays, count, 0.001f, 5000.1f, hits);
+		for (uint32_t lane = 0; lane < count; ++lane)
+		{
+			m_paths[m_extension[first + lane]].hit = hits[lane];
+		}
+	}
+#endif
+}
+
+// Diffuse bounces leave in unrelated directions, so consecutive rays of a queue in
+// path order touch unrelated BVH nodes and spheres. Sorted by origin, quantized in
+// this bounce's origin bounds, and direction, under their direction octant, nearby
+// rays heading the same way follow each other and find their nodes in cache. Paths
+// are independent, so the order changes nothing but the memory traffic
+void Wavefront::Reorder() noexcept
+{
+	RT_PROFILE_SCOPE("Reorder rays", static_cast<uint32_t>(m_extension.size()));
+
+	AABB bounds;
+	for (uint32_t index : m_extension)
+	{
+		bounds.Grow(m_paths[index].ray.origin);
+	}
+	const Vec3f extent = bounds.Extent();
+	const Vec3f scale(1024.0f / fmaxf(extent.x, 1e-6f), 1024.0f / fmaxf(extent.y, 1e-6f), 1024.0f / fmaxf(extent.z, 1e-6f));
+
+	m_sortKeys.clear();
+	for (uint32_t index : m_extension)
+	{
+		const Ray& ray = m_paths[index].ray;
+		const Vec3f direction = unit_vector(ray.direction);
+		const uint64_t octant = (direction.x < 0.0f ? 1u : 0u) | (direction.y < 0.0f ? 2u : 0u) | (direction.z < 0.0f ? 4u : 0u);
+		const uint64_t origin = Morton(Quantize(ray.origin.x, bounds.min.x, scale.x, 1023), Quantize(ray.origin.y, bounds.min.y, scale.y, 1023), Quantize(ray.origin.z, bounds.min.z, scale.z, 1023));
+		const uint64_t heading = Morton(Quantize(direction.x, -1.0f, 4.0f, 7), Quantize(direction.y, -1.0f, 4.0f, 7), Quantize(direction.z, -1.0f, 4.0f, 7));
+		m_sortKeys.push_back({ (octant << (ORIGIN_BITS + DIRECTION_BITS)) | (origin << DIRECTION_BITS) | heading, index });
+	}
+	std::sort(m_sortKeys.begin(), m_sortKeys.end());
+
+	for (size_t i = 0; i < m_sortKeys.size(); ++i)
+	{
+		m_extension[i] = m_sortKeys[i].second;
+	}
+
+	if constexpr (STATS::ENABLED)
+	{
+		uint64_t bins = 0;
+		for (size_t i = 0; i < m_sortKeys.size(); ++i)
+		{
+			bins += i == 0 || (m_sortKeys[i].first >> BIN_SHIFT) != (m_sortKeys[i - 1].first >> BIN_SHIFT);
+		}
+		RT_STAT_ADD(STATS::REORDERED_RAYS, m_sortKeys.size());
+		RT_STAT_ADD(STATS::REORDER_BINS, bins);
+	}
+}
+
+void Wavefront::ShadeEscaped(const Scene& scene, [[maybe_unused]] int depth) noexcept
+{
+	for (uint32_t index : m_escaped)
+	{
+		Path& path = m_paths[index];
+		RT_STAT_ADD(STATS::ESCAPED, 1);
+		RT_STAT_PATH(depth);
+		path.radiance += path.throughput * scene.Background(path.ray.direction);
+	}
+}
+
+void Wavefront::ShadeEmissive(const Scene& scene, [[maybe_unused]] int depth) noexcept
+{
+	for (uint32_t index : m_materialQueues[static_cast<size_t>(MaterialType::EMISSIVE)])
+	{
+		Path& path = m_paths[index];
+		RT_STAT_ADD(STATS::EMITTER_HITS, 1);
+		RT_STAT_PATH(depth);
+		path.radiance += path.throughput * scene.GetMaterial(path.hit.materialID).Emission * scene.EmissionWeight(path.lastPosition, path.lastPdf, path.hit);
+	}
+}
+
+void Wavefront::TraceShadows(const Scene& scene) noexcept
+{
+	for (const ShadowRay& shadow : m_shadowRays)
+	{
+		if (!scene.Occluded(shadow.ray, 0.001f, shadow.distance))
+		{
+			m_paths[shadow.path].radiance += shadow.radiance;
+		}
+	}
+}
+
+template <MaterialType type>
+void Wavefront::Shade(const Scene& scene, int depth, const Settings& settings) noexcept
+{
+	const bool sampleLights = type == MaterialType::LAMBERTIAN && settings.lightSampling && scene.LightCount() > 0;
+	for (uint32_t index : m_materialQueues[static_cast<size_t>(type)])
+	{
+		Path& path = m_paths[index];
+		const Material& material = scene.GetMaterial(path.hit.materialID);
+
+		if (sampleLights)
+		{
+			ShadowRay shadow;
+			Vec3f contribution;
+			if (scene.SampleDirectLight(path.hit, material, path.sampler, shadow.ray, shadow.distance, contribution))
+			{
+				RT_STAT_ADD(STATS::SHADOW_RAYS, 1);
+				shadow.radiance = path.throughput * contribution;
+				shadow.path = index;
+				m_shadowRays.push_back(shadow);
+			}
+		}
+
+		Ray scattered;
+		Vec3f attenuation;
+		bool scatters;
+		if constexpr (type == MaterialType::LAMBERTIAN)
+		{
+			scatters = material.ScatterLambertian(path.hit, attenuation, scattered, path.sampler);
+		}
+		else if constexpr (type == MaterialType::METALLIC)
+		{
+			scatters = material.ScatterMetallic(path.ray, path.hit, attenuation, scattered, path.sampler);
+		}
+		else
+		{
+			scatters = material.ScatterDielectric(path.ray, path.hit, attenuation, scattered, path.sampler);
+		}
+
+		if (!scatters)
+		{
+			RT_STAT_ADD(STATS::ABSORBED, 1);
+			RT_STAT_PATH(depth);
+			continue;
+		}
+		RT_STAT_ADD(STATS::SCATTER_LAMBERTIAN + static_cast<uint32_t>(type), 1);
+		path.throughput *= attenuation;
+		path.lastPosition = path.hit.p;
+		path.lastPdf = sampleLights ? Material::LambertianPdf(path.hit.normal, unit_vector(scattered.direction)) : 0.0f;
+
+		if (depth >= settings.rouletteStartDepth && !SurviveRoulette(path.sampler, path.throughput))
+		{
+			RT_STAT_ADD(STATS::ROULETTE_KILLS, 1);
+			RT_STAT_PATH(depth + 1);
+			continue;
+		}
+		path.ray = scattered;
+		m_nextExtension.push_back(index);
+	}
+}